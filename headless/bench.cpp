@@ -0,0 +1,326 @@
+// Headless micro-benchmarks for process() of every Ondas module.
+//
+// Each scenario patches one module the way it's used in a real rack, then times process() at the common engine
+// sample rates. Results are reported as ns per sample, samples per second and the share of one CPU core the module
+// would take at that rate, which is what Rack's CPU meter shows.
+//
+// Usage: bench [-t seconds] [-r repeats] [filter...]
+// A filter selects scenarios whose "Module/scenario" name contains it.
+#include "harness.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+using namespace headless;
+
+
+struct Scenario {
+	std::string slug;
+	std::string name;
+	std::function<void(Instance&)> patch;
+	// Scenarios for a whole row of modules add them to the Row instead, and are reported under the slug "Row"
+	std::function<void(Row&)> patchRow;
+
+	Scenario() {}
+	Scenario(std::string slug, std::string name, std::function<void(Instance&)> patch) : slug(slug), name(name), patch(patch) {}
+};
+
+
+static std::vector<Scenario> scenarios() {
+	std::vector<Scenario> s;
+
+	// Klok
+	s.push_back({"Klok", "stopped", [](Instance& m) {
+		m.connectOutput("*");
+	}});
+	s.push_back({"Klok", "running, all outputs", [](Instance& m) {
+		m.setParam("Run clock", 1.f);
+		m.setParam("Set tempo", 174.f);
+		m.connectOutput("*");
+	}});
+	s.push_back({"Klok", "running, poly output only", [](Instance& m) {
+		m.setParam("Run clock", 1.f);
+		m.setParam("Set tempo", 174.f);
+		m.connectOutput("Polyphonic modulo");
+	}});
+
+	// Secu
+	s.push_back({"Secu", "unpatched", [](Instance& m) {
+	}});
+	s.push_back({"Secu", "8th clock, all tracks", [](Instance& m) {
+		m.setParam("Set gate *", 1.f);
+		m.connectInput("Trigger", Signal::clock(240.f, 5e-3f));
+		m.connectOutput("Trigger *");
+	}});
+	s.push_back({"Secu", "8th clock, all tracks, poly output only", [](Instance& m) {
+		m.setParam("Set gate *", 1.f);
+		m.connectInput("Trigger", Signal::clock(240.f, 5e-3f));
+		m.connectOutput("Polyphonic triggers");
+	}});
+	s.push_back({"Secu", "8th clock, probability CV, randomize every beat", [](Instance& m) {
+		m.connectInput("Trigger", Signal::clock(240.f, 5e-3f));
+		m.connectInput("Probability", Signal::sine(0.5f, 1.f));
+		m.connectInput("Randomize", Signal::clock(120.f));
+		m.connectOutput("Trigger *");
+	}});
+
+	// BaBum
+	s.push_back({"BaBum", "unpatched", [](Instance& m) {
+		m.connectOutput("*");
+	}});
+	s.push_back({"BaBum", "kick every beat", [](Instance& m) {
+		m.connectInput("Trigger Kick", Signal::clock(120.f));
+		m.connectOutput("Kick");
+		m.connectOutput("Mix");
+	}});
+	s.push_back({"BaBum", "all parts every beat", [](Instance& m) {
+		m.connectInput("Trigger *", Signal::clock(120.f));
+		m.connectInput("Tune *", Signal::sine(0.25f, 5.f));
+		m.connectOutput("*");
+	}});
+	s.push_back({"BaBum", "all parts every beat, 8 voices", [](Instance& m) {
+		m.connectInput("Trigger *", Signal::clock(120.f), 8);
+		m.connectInput("Tune *", Signal::sine(0.25f, 5.f), 8);
+		m.connectOutput("*");
+	}});
+
+	s.push_back({"BaBum", "all parts every beat, 4x drive oversampling", [](Instance& m) {
+		m.setData("oversampling", json_integer(4));
+		m.connectInput("Trigger *", Signal::clock(120.f));
+		m.connectInput("Tune *", Signal::sine(0.25f, 5.f));
+		m.connectOutput("*");
+	}});
+
+	// Scener
+	s.push_back({"Scener", "trigger only", [](Instance& m) {
+		m.connectInput("Trigger", Signal::clock(120.f));
+	}});
+	s.push_back({"Scener", "all scenes patched, xfade", [](Instance& m) {
+		m.setParam("Crossfade transition time", 0.5f);
+		m.connectInput("Trigger", Signal::clock(480.f));
+		m.connectInput("Signal *", Signal::sine(220.f));
+		m.connectOutput("*");
+	}});
+	s.push_back({"Scener", "16-voice poly rows, xfade", [](Instance& m) {
+		m.setParam("Crossfade transition time", 0.5f);
+		m.connectInput("Trigger", Signal::clock(480.f));
+		m.connectInput("Signal 0 scene *", Signal::sine(220.f), 16);
+		m.connectOutput("Signal 0");
+	}});
+	s.push_back({"Scener", "32-scene arrangement, xfade", [](Instance& m) {
+		json_t* arrangementJ = json_array();
+		for (int i = 0; i < 32; i++) {
+			json_t* sceneJ = json_array();
+			json_array_append_new(sceneJ, json_integer(i % 6));
+			json_array_append_new(sceneJ, json_integer(1 + i % 4));
+			json_array_append_new(arrangementJ, sceneJ);
+		}
+		m.setData("arrangement", arrangementJ);
+		m.setParam("Crossfade transition time", 0.5f);
+		m.connectInput("Trigger", Signal::clock(480.f));
+		m.connectInput("Signal *", Signal::sine(220.f));
+		m.connectOutput("*");
+	}});
+
+	// Distroi
+	s.push_back({"Distroi", "unpatched", [](Instance& m) {
+	}});
+	s.push_back({"Distroi", "bitcrush only", [](Instance& m) {
+		m.setParam("Bitcrush effect quantity", 0.5f);
+		m.connectInput("Bitcrush signal", Signal::saw(110.f));
+		m.connectOutput("Bitcrush");
+	}});
+	s.push_back({"Distroi", "distort only, 4x oversampling", [](Instance& m) {
+		m.setData("oversampling", json_integer(4));
+		m.setParam("Distort effect quantity", 0.5f);
+		m.connectInput("Distort signal", Signal::saw(110.f));
+		m.connectOutput("Distort");
+	}});
+	s.push_back({"Distroi", "glitch only", [](Instance& m) {
+		m.setParam("Glitch effect quantity", 0.5f);
+		m.connectInput("Glitch signal", Signal::saw(110.f));
+		m.connectOutput("Glitch");
+	}});
+	s.push_back({"Distroi", "glitch, 8 grains at full quantity, 16 voices", [](Instance& m) {
+		m.setData("glitchGrains", json_integer(8));
+		m.setParam("Glitch effect quantity", 1.f);
+		m.connectInput("Glitch signal", Signal::saw(110.f), 16);
+		m.connectOutput("Glitch");
+	}});
+	s.push_back({"Distroi", "spectral freeze only", [](Instance& m) {
+		m.setData("spectral", json_true());
+		m.setParam("Spectral effect quantity", 0.5f);
+		m.connectInput("Spectral signal", Signal::saw(110.f));
+		m.connectOutput("Spectral");
+	}});
+	s.push_back({"Distroi", "spectral decimate, 2048 FFT, 16 voices", [](Instance& m) {
+		m.setData("spectral", json_true());
+		m.setData("spectralMode", json_integer(2));
+		m.setData("spectralSize", json_integer(2048));
+		m.setParam("Spectral effect quantity", 0.5f);
+		m.connectInput("Spectral signal", Signal::saw(110.f), 16);
+		m.connectOutput("Spectral");
+	}});
+	s.push_back({"Distroi", "all effects, CV", [](Instance& m) {
+		for (std::string effect : {"Bitcrush", "Decimate", "Distort", "Glitch", "Crop"}) {
+			m.setParam(effect + " effect quantity", 0.5f);
+			m.setParam(effect + " CV attenuator", 0.5f);
+			m.connectInput(effect + " signal", Signal::saw(110.f));
+			m.connectInput(effect + " CV", Signal::sine(0.3f, 5.f));
+		}
+		m.connectOutput("*");
+	}});
+	s.push_back({"Distroi", "all effects, CV, 16 voices", [](Instance& m) {
+		for (std::string effect : {"Bitcrush", "Decimate", "Distort", "Glitch", "Crop"}) {
+			m.setParam(effect + " effect quantity", 0.5f);
+			m.setParam(effect + " CV attenuator", 0.5f);
+			m.connectInput(effect + " signal", Signal::saw(110.f), 16);
+			m.connectInput(effect + " CV", Signal::sine(0.3f, 5.f), 16);
+		}
+		m.connectOutput("*");
+	}});
+	s.push_back({"Distroi", "chain of all effects, CV, 2x oversampling", [](Instance& m) {
+		m.setData("chain", json_true());
+		m.setData("oversampling", json_integer(2));
+		for (std::string effect : {"Bitcrush", "Decimate", "Distort", "Glitch", "Crop"}) {
+			m.setParam(effect + " effect quantity", 0.5f);
+			m.setParam(effect + " CV attenuator", 0.5f);
+			m.connectInput(effect + " CV", Signal::sine(0.3f, 5.f));
+		}
+		m.connectInput("Bitcrush signal", Signal::saw(110.f));
+		m.connectOutput("Crop");
+	}});
+
+	// Rows, timing every module in the row together
+	Scenario row;
+	row.slug = "Row";
+	row.name = "Klok, Secu, BaBum over the transport";
+	row.patchRow = [](Row& r) {
+		Instance& klok = r.add("Klok");
+		klok.setParam("Run clock", 1.f);
+		klok.setParam("Set tempo", 174.f);
+		Instance& secu = r.add("Secu");
+		secu.setParam("Set gate *", 1.f);
+		Instance& babum = r.add("BaBum");
+		babum.connectOutput("*");
+	};
+	s.push_back(row);
+
+	// The same chain as Distroi's chain mode, patched with cables
+	Scenario cabled;
+	cabled.slug = "Row";
+	cabled.name = "Distroi, all effects cabled in series, CV, 2x";
+	cabled.patchRow = [](Row& r) {
+		Instance& m = r.add("Distroi");
+		m.setData("oversampling", json_integer(2));
+		std::vector<std::string> effects = {"Bitcrush", "Decimate", "Distort", "Glitch", "Crop"};
+		for (size_t i = 0; i < effects.size(); i++) {
+			m.setParam(effects[i] + " effect quantity", 0.5f);
+			m.setParam(effects[i] + " CV attenuator", 0.5f);
+			m.connectInput(effects[i] + " CV", Signal::sine(0.3f, 5.f));
+			if (i > 0)
+				r.connect(m, m.findOutputs(effects[i - 1])[0], m, m.findInputs(effects[i] + " signal")[0]);
+		}
+		m.connectInput("Bitcrush signal", Signal::saw(110.f));
+		m.connectOutput("Crop");
+	};
+	s.push_back(cabled);
+
+	return s;
+}
+
+
+struct Result {
+	double nsPerSample;
+};
+
+
+template <class TTarget>
+static Result measure(TTarget& instance, float sampleRate, float seconds, int repeats) {
+	const int blockFrames = 4096;
+	// Warm up caches, buffers and envelopes before timing
+	instance.step(int(sampleRate * 0.25f));
+
+	int64_t frames = std::max<int64_t>(blockFrames, int64_t(sampleRate * seconds));
+	double best = INFINITY;
+	for (int r = 0; r < repeats; r++) {
+		double ns = 0.0;
+		int64_t done = 0;
+		while (done < frames) {
+			instance.fill(blockFrames);
+			auto start = std::chrono::steady_clock::now();
+			instance.run();
+			auto end = std::chrono::steady_clock::now();
+			ns += std::chrono::duration<double, std::nano>(end - start).count();
+			done += blockFrames;
+		}
+		best = std::min(best, ns / done);
+	}
+	return Result{best};
+}
+
+
+static Result measure(const Scenario& scenario, float sampleRate, float seconds, int repeats) {
+	if (scenario.patchRow) {
+		Row row(sampleRate);
+		scenario.patchRow(row);
+		return measure(row, sampleRate, seconds, repeats);
+	}
+	Instance instance(scenario.slug, sampleRate);
+	scenario.patch(instance);
+	return measure(instance, sampleRate, seconds, repeats);
+}
+
+
+int main(int argc, char** argv) {
+	float seconds = 2.f;
+	int repeats = 3;
+	std::vector<std::string> filters;
+
+	for (int i = 1; i < argc; i++) {
+		if (!std::strcmp(argv[i], "-t") && i + 1 < argc) {
+			seconds = std::atof(argv[++i]);
+		}
+		else if (!std::strcmp(argv[i], "-r") && i + 1 < argc) {
+			repeats = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (!std::strcmp(argv[i], "-h") || !std::strcmp(argv[i], "--help")) {
+			std::printf("Usage: %s [-t seconds] [-r repeats] [filter...]\n", argv[0]);
+			return 0;
+		}
+		else {
+			filters.push_back(argv[i]);
+		}
+	}
+
+	const float sampleRates[] = {44100.f, 48000.f, 96000.f, 192000.f};
+
+	std::printf("%-8s %-48s %7s %10s %12s %7s\n", "module", "scenario", "rate", "ns/sample", "Msamples/s", "%core");
+	for (const Scenario& scenario : scenarios()) {
+		std::string fullName = scenario.slug + "/" + scenario.name;
+		bool selected = filters.empty();
+		for (const std::string& filter : filters) {
+			if (fullName.find(filter) != std::string::npos)
+				selected = true;
+		}
+		if (!selected)
+			continue;
+
+		for (float sampleRate : sampleRates) {
+			Result result;
+			try {
+				result = measure(scenario, sampleRate, seconds, repeats);
+			}
+			catch (std::exception& e) {
+				std::fprintf(stderr, "%s: %s\n", fullName.c_str(), e.what());
+				return 1;
+			}
+			double samplesPerSecond = 1e9 / result.nsPerSample;
+			double core = 100.0 * sampleRate / samplesPerSecond;
+			std::printf("%-8s %-48s %7.0f %10.2f %12.2f %7.3f\n", scenario.slug.c_str(), scenario.name.c_str(), sampleRate, result.nsPerSample, samplesPerSecond / 1e6, core);
+			std::fflush(stdout);
+		}
+	}
+	return 0;
+}
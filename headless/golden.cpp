@@ -0,0 +1,353 @@
+// Golden renders: checks that a change to the DSP code keeps every module sounding the same.
+//
+// Each scenario patches a row of modules with scripted clocks, triggers and CV sweeps, fixes the seed of every random
+// generator and renders all patched outputs for a second or a few at 24 kHz. `record` writes the renders as WAV files,
+// one per scenario with a channel per output channel. `check` renders again and compares against those files.
+// The references in golden/ are checked in, so every clone can check against them. They are kept short and at a low
+// rate to keep them small. Re-record a scenario only when its sound is meant to change, and commit it with that change.
+//
+// Usage: golden record|check [-d dir] [-e tolerance] [filter...]
+// The tolerance is the largest difference allowed on any sample, in volts. A filter selects scenarios whose
+// "Module/scenario" name contains it.
+#include "harness.hpp"
+#include "wav.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace headless;
+
+
+static const float SAMPLE_RATE = 24000.f;
+
+
+struct GoldenScenario {
+	std::string slug; // First module of the row, for selecting and naming
+	std::string name;
+	float seconds;
+	std::function<void(Row&)> patch;
+};
+
+
+static std::vector<GoldenScenario> scenarios() {
+	std::vector<GoldenScenario> s;
+
+	s.push_back({"Klok", "running at 137 BPM", 2.f, [](Row& r) {
+		Instance& m = r.add("Klok");
+		m.setParam("Run clock", 1.f);
+		m.setParam("Set tempo", 137.f);
+		m.connectOutput("Reset");
+		m.connectOutput("Modulo *");
+	}});
+	s.push_back({"Klok", "poly output at 137 BPM", 2.f, [](Row& r) {
+		Instance& m = r.add("Klok");
+		m.setParam("Run clock", 1.f);
+		m.setParam("Set tempo", 137.f);
+		m.connectOutput("Polyphonic modulo");
+	}});
+
+	s.push_back({"Secu", "8th clock, probability CV, randomize every beat", 4.f, [](Row& r) {
+		Instance& m = r.add("Secu");
+		m.setData("seed", json_integer(1));
+		m.connectInput("Trigger", Signal::clock(240.f, 5e-3f));
+		m.connectInput("Probability", Signal::sine(0.5f, 1.f));
+		m.connectInput("Randomize", Signal::clock(120.f));
+		m.connectOutput("Trigger *");
+	}});
+	s.push_back({"Secu", "poly output, 8th clock, probability CV, randomize every beat", 4.f, [](Row& r) {
+		Instance& m = r.add("Secu");
+		m.setData("seed", json_integer(1));
+		m.connectInput("Trigger", Signal::clock(240.f, 5e-3f));
+		m.connectInput("Probability", Signal::sine(0.5f, 1.f));
+		m.connectInput("Randomize", Signal::clock(120.f));
+		m.connectOutput("Polyphonic triggers");
+	}});
+
+	s.push_back({"BaBum", "all parts, tune sweeps", 1.f, [](Row& r) {
+		Instance& m = r.add("BaBum");
+		m.setData("seed", json_integer(2));
+		m.connectInput("Trigger *", Signal::clock(150.f, 5e-3f));
+		m.connectInput("Tune *", Signal::sine(0.25f, 5.f));
+		m.connectOutput("*");
+	}});
+	s.push_back({"BaBum", "all parts, 4 voices, 4x drive oversampling", 1.f, [](Row& r) {
+		Instance& m = r.add("BaBum");
+		m.setData("seed", json_integer(3));
+		m.setData("oversampling", json_integer(4));
+		m.setParam("Kick distortion", 6.f);
+		m.setParam("Snare distortion", 5.f);
+		m.setParam("FX distortion", 30.f);
+		m.connectInput("Trigger *", Signal::clock(300.f, 5e-3f), 4);
+		m.connectInput("Tune *", Signal::saw(0.5f, 3.f), 4);
+		m.connectOutput("*");
+	}});
+
+	s.push_back({"Scener", "all scenes, xfade", 1.f, [](Row& r) {
+		Instance& m = r.add("Scener");
+		m.setParam("Crossfade transition time", 0.2f);
+		m.setParam("Steps scene *", 2.f);
+		m.setParam("Alert *", 0.5f);
+		// A patch from before the equal power option, which has to keep its linear crossfade like the reference
+		m.loadWithoutData();
+		m.connectInput("Trigger", Signal::clock(480.f));
+		m.connectInput("Signal *", Signal::saw(110.f));
+		m.connectOutput("*");
+	}});
+	s.push_back({"Scener", "poly rows, equal power xfade", 1.f, [](Row& r) {
+		Instance& m = r.add("Scener");
+		m.setParam("Crossfade transition time", 0.2f);
+		m.setParam("Steps scene *", 2.f);
+		m.connectInput("Trigger", Signal::clock(480.f));
+		m.connectInput("Signal 0 scene *", Signal::saw(110.f), 16);
+		m.connectInput("Signal 1 scene 0", Signal::sine(220.f), 5);
+		m.connectInput("Signal 1 scene 3", Signal::sine(330.f));
+		m.connectOutput("Signal *");
+	}});
+
+	s.push_back({"Distroi", "all effects, CV", 1.f, [](Row& r) {
+		Instance& m = r.add("Distroi");
+		m.setData("seed", json_integer(4));
+		for (std::string effect : {"Bitcrush", "Decimate", "Distort", "Glitch", "Crop"}) {
+			m.setParam(effect + " effect quantity", 0.5f);
+			m.setParam(effect + " CV attenuator", 0.5f);
+			m.connectInput(effect + " signal", Signal::saw(110.f));
+			m.connectInput(effect + " CV", Signal::sine(0.3f, 5.f));
+		}
+		m.connectOutput("*");
+	}});
+	s.push_back({"Distroi", "bitcrush and distort, 4x oversampling, 4 voices", 1.f, [](Row& r) {
+		Instance& m = r.add("Distroi");
+		m.setData("seed", json_integer(5));
+		m.setData("oversampling", json_integer(4));
+		for (std::string effect : {"Bitcrush", "Distort"}) {
+			m.setParam(effect + " effect quantity", 0.7f);
+			m.connectInput(effect + " signal", Signal::saw(220.f), 4);
+			m.connectInput(effect + " CV", Signal::sine(0.5f, 5.f), 4);
+		}
+		m.connectOutput("*");
+	}});
+	s.push_back({"Distroi", "chain, bitcrush and distort sharing 2x oversampling, 4 voices", 1.f, [](Row& r) {
+		Instance& m = r.add("Distroi");
+		m.setData("seed", json_integer(8));
+		m.setData("oversampling", json_integer(2));
+		m.setData("chain", json_true());
+		json_t* orderJ = json_array();
+		for (int effect : {1, 0, 2, 4, 3})
+			json_array_append_new(orderJ, json_integer(effect));
+		m.setData("chainOrder", orderJ);
+		for (std::string effect : {"Bitcrush", "Decimate", "Distort", "Glitch", "Crop"}) {
+			m.setParam(effect + " effect quantity", 0.4f);
+			m.setParam(effect + " CV attenuator", 0.5f);
+			m.connectInput(effect + " CV", Signal::sine(0.7f, 5.f));
+		}
+		m.connectInput("Bitcrush signal", Signal::saw(110.f), 4);
+		m.connectOutput("*");
+	}});
+	s.push_back({"Distroi", "glitch grains, 8 at full quantity, CV, 2 voices", 1.f, [](Row& r) {
+		Instance& m = r.add("Distroi");
+		m.setData("seed", json_integer(12));
+		m.setData("glitchGrains", json_integer(8));
+		m.setParam("Glitch effect quantity", 0.6f);
+		m.setParam("Glitch CV attenuator", 0.4f);
+		m.setParam("Glitch dry/wet", 0.9f);
+		m.connectInput("Glitch signal", Signal::saw(110.f), 2);
+		m.connectInput("Glitch CV", Signal::sine(0.5f, 5.f), 2);
+		m.connectOutput("Glitch");
+	}});
+	s.push_back({"Distroi", "spectral freeze, bin shuffle and decimate, 2 voices, CV", 1.f, [](Row& r) {
+		// One module per mode, each at its own FFT size
+		for (int mode = 0; mode < 3; mode++) {
+			Instance& m = r.add("Distroi");
+			m.setData("seed", json_integer(9 + mode));
+			m.setData("spectral", json_true());
+			m.setData("spectralMode", json_integer(mode));
+			m.setData("spectralSize", json_integer(256 << mode));
+			m.setParam("Spectral effect quantity", 0.6f);
+			m.setParam("Spectral CV attenuator", 0.4f);
+			m.setParam("Spectral dry/wet", 0.8f);
+			m.connectInput("Spectral signal", Signal::saw(110.f), 2);
+			m.connectInput("Spectral CV", Signal::sine(0.5f, 5.f), 2);
+			m.connectOutput("Spectral");
+		}
+	}});
+
+	s.push_back({"Klok", "Klok, Secu, BaBum, Scener over the transport", 2.f, [](Row& r) {
+		Instance& klok = r.add("Klok");
+		klok.setParam("Run clock", 1.f);
+		klok.setParam("Set tempo", 174.f);
+		Instance& secu = r.add("Secu");
+		secu.setData("seed", json_integer(6));
+		secu.setParam("Set gate *", 1.f);
+		secu.setParam("Glitch probability", 0.3f);
+		Instance& babum = r.add("BaBum");
+		babum.setData("seed", json_integer(7));
+		babum.connectOutput("*");
+		Instance& scener = r.add("Scener");
+		scener.connectInput("Signal *", Signal::saw(55.f));
+		scener.connectOutput("*");
+	}});
+
+	return s;
+}
+
+
+static std::string fileName(const GoldenScenario& scenario) {
+	std::string name = scenario.slug + "-" + scenario.name;
+	for (char& ch : name) {
+		if (!std::isalnum((unsigned char) ch))
+			ch = '-';
+	}
+	return name + ".wav";
+}
+
+
+static Wav render(const GoldenScenario& scenario, Capture& capture) {
+	Row row(SAMPLE_RATE);
+	scenario.patch(row);
+
+	Wav wav;
+	wav.sampleRate = SAMPLE_RATE;
+	int64_t frames = int64_t(scenario.seconds * SAMPLE_RATE);
+	const int blockFrames = 4096;
+	for (int64_t done = 0; done < frames; done += blockFrames) {
+		int n = std::min<int64_t>(blockFrames, frames - done);
+		row.fill(n);
+		for (int i = 0; i < n; i++) {
+			row.processFrame(i);
+			if (done + i == 0)
+				capture.addAll(row);
+			capture.append(wav.samples);
+		}
+	}
+	wav.channels = capture.channels.size();
+	return wav;
+}
+
+
+/** Compares a render against its reference and prints the outcome. Returns true if every sample is within tolerance. */
+static bool compare(const std::string& fullName, const Wav& wav, const Wav& reference, const Capture& capture, float tolerance) {
+	if (wav.sampleRate != reference.sampleRate) {
+		std::printf("FAIL  %-60s rendered at %d Hz, reference at %d Hz\n", fullName.c_str(), wav.sampleRate, reference.sampleRate);
+		return false;
+	}
+	if (wav.channels != reference.channels || wav.frames() != reference.frames()) {
+		std::printf("FAIL  %-60s %d channels, %lld frames, reference has %d, %lld\n", fullName.c_str(), wav.channels, (long long) wav.frames(), reference.channels, (long long) reference.frames());
+		return false;
+	}
+	float worst = 0.f;
+	int worstChannel = 0;
+	int64_t worstFrame = 0;
+	for (int64_t f = 0; f < wav.frames(); f++) {
+		for (int c = 0; c < wav.channels; c++) {
+			float a = wav.get(f, c);
+			float b = reference.get(f, c);
+			// A NaN matches only a NaN
+			float error = (std::isnan(a) || std::isnan(b)) ? (std::isnan(a) == std::isnan(b) ? 0.f : INFINITY) : std::fabs(a - b);
+			if (error > worst) {
+				worst = error;
+				worstChannel = c;
+				worstFrame = f;
+			}
+		}
+	}
+	bool pass = worst <= tolerance;
+	std::printf("%s  %-60s max error %.3g V", pass ? "pass" : "FAIL", fullName.c_str(), worst);
+	if (worst > 0.f)
+		std::printf(" on %s at %.4f s", capture.channels[worstChannel].name.c_str(), worstFrame / SAMPLE_RATE);
+	std::printf("\n");
+	return pass;
+}
+
+
+int main(int argc, char** argv) {
+	std::string mode;
+	std::string dir = "golden";
+	float tolerance = 1e-4f;
+	std::vector<std::string> filters;
+
+	for (int i = 1; i < argc; i++) {
+		if (!std::strcmp(argv[i], "-d") && i + 1 < argc) {
+			dir = argv[++i];
+		}
+		else if (!std::strcmp(argv[i], "-e") && i + 1 < argc) {
+			tolerance = std::atof(argv[++i]);
+		}
+		else if (!std::strcmp(argv[i], "-h") || !std::strcmp(argv[i], "--help")) {
+			std::printf("Usage: %s record|check [-d dir] [-e tolerance] [filter...]\n", argv[0]);
+			return 0;
+		}
+		else if (mode.empty()) {
+			mode = argv[i];
+		}
+		else {
+			filters.push_back(argv[i]);
+		}
+	}
+	if (mode != "record" && mode != "check") {
+		std::fprintf(stderr, "Usage: %s record|check [-d dir] [-e tolerance] [filter...]\n", argv[0]);
+		return 2;
+	}
+	if (mode == "record" && !system::createDirectories(dir)) {
+		std::fprintf(stderr, "Could not create %s\n", dir.c_str());
+		return 1;
+	}
+
+	int failures = 0;
+	int missing = 0;
+	int selectedCount = 0;
+	for (const GoldenScenario& scenario : scenarios()) {
+		std::string fullName = scenario.slug + "/" + scenario.name;
+		bool selected = filters.empty();
+		for (const std::string& filter : filters) {
+			if (fullName.find(filter) != std::string::npos)
+				selected = true;
+		}
+		if (!selected)
+			continue;
+		selectedCount++;
+
+		std::string path = system::join(dir, fileName(scenario));
+		Capture capture;
+		Wav wav;
+		try {
+			wav = render(scenario, capture);
+		}
+		catch (std::exception& e) {
+			std::fprintf(stderr, "%s: %s\n", fullName.c_str(), e.what());
+			return 1;
+		}
+
+		if (mode == "record") {
+			if (!wav.write(path)) {
+				std::fprintf(stderr, "Could not write %s\n", path.c_str());
+				return 1;
+			}
+			std::printf("wrote %-60s %d channels to %s\n", fullName.c_str(), wav.channels, path.c_str());
+			continue;
+		}
+
+		Wav reference;
+		if (!reference.read(path)) {
+			std::fprintf(stderr, "MISSING  %-57s no reference at %s\n", fullName.c_str(), path.c_str());
+			missing++;
+			continue;
+		}
+		if (!compare(fullName, wav, reference, capture, tolerance))
+			failures++;
+	}
+
+	if (selectedCount == 0) {
+		std::fprintf(stderr, "No scenario matches the filters\n");
+		return 1;
+	}
+	if (mode == "check") {
+		// The references are checked in, so a missing one is a scenario added or renamed without recording it
+		if (missing)
+			std::fprintf(stderr, "%d scenario(s) have no reference in %s. Record them and commit the files.\n", missing, dir.c_str());
+		if (failures)
+			std::printf("%d scenario(s) differ from the reference renders\n", failures);
+		if (!missing && !failures)
+			std::printf("All scenarios match the reference renders within %g V\n", tolerance);
+	}
+	return (failures || missing) ? 1 : 0;
+}
@@ -0,0 +1,429 @@
+#pragma once
+// Drives Ondas modules outside of Rack, against the stub API in headless/rack.hpp.
+//
+// An Instance owns one module and plays the part of the engine for it: it feeds signal generators into input ports,
+// marks output ports as patched and calls process() once per frame with the same ProcessArgs Rack would pass.
+// Ports and params are looked up by the names given to configInput/configOutput/configParam, so harness code doesn't
+// need the module's enums (they live in the module's .cpp file).
+#include "plugin.hpp"
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+
+namespace headless {
+
+
+/** Test signal fed into an input port. Everything is in Rack voltages. */
+struct Signal {
+	enum Type {
+		DC,
+		CLOCK,
+		SINE,
+		SAW,
+		NOISE,
+	};
+
+	Type type = DC;
+	float freq = 0.f; // Hz
+	float amp = 0.f; // Peak voltage (DC: the voltage)
+	float width = 1e-3f; // CLOCK: pulse width in seconds
+	float offset = 0.f; // CLOCK: delay of the first pulse in seconds
+	double phase = 0.0;
+	uint32_t noiseState = 22222;
+
+	static Signal dc(float v) {
+		Signal s;
+		s.type = DC;
+		s.amp = v;
+		return s;
+	}
+	/** 10V trigger pulses at `bpm` beats per minute. */
+	static Signal clock(float bpm, float width = 1e-3f, float offset = 0.f) {
+		Signal s;
+		s.type = CLOCK;
+		s.freq = bpm / 60.f;
+		s.amp = 10.f;
+		s.width = width;
+		s.offset = offset;
+		return s;
+	}
+	static Signal sine(float freq, float amp = 5.f) {
+		Signal s;
+		s.type = SINE;
+		s.freq = freq;
+		s.amp = amp;
+		return s;
+	}
+	static Signal saw(float freq, float amp = 5.f) {
+		Signal s;
+		s.type = SAW;
+		s.freq = freq;
+		s.amp = amp;
+		return s;
+	}
+	static Signal noise(float amp = 5.f) {
+		Signal s;
+		s.type = NOISE;
+		s.amp = amp;
+		return s;
+	}
+
+	float next(float sampleTime) {
+		float out = 0.f;
+		switch (type) {
+			case DC: {
+				out = amp;
+			} break;
+			case CLOCK: {
+				double t = phase - offset * freq;
+				out = (t >= 0.0 && (t - std::floor(t)) * (1.0 / freq) < width) ? amp : 0.f;
+			} break;
+			case SINE: {
+				out = amp * (float) std::sin(2.0 * M_PI * phase);
+			} break;
+			case SAW: {
+				out = amp * (float) (2.0 * (phase - std::floor(phase)) - 1.0);
+			} break;
+			case NOISE: {
+				noiseState = noiseState * 1664525u + 1013904223u;
+				out = amp * ((noiseState >> 8) * (1.f / 8388608.f) - 1.f);
+			} break;
+		}
+		phase += freq * (double) sampleTime;
+		return out;
+	}
+};
+
+
+inline Plugin* plugin() {
+	static Plugin* p = NULL;
+	if (!p) {
+		p = new Plugin;
+		p->slug = "Ondas";
+		init(p);
+	}
+	return p;
+}
+
+inline Model* findModel(const std::string& slug) {
+	Model* model = plugin()->getModel(slug);
+	if (!model)
+		throw std::runtime_error("Unknown module " + slug);
+	return model;
+}
+
+
+/** Matches a configured name against a pattern. A trailing '*' matches any suffix. */
+inline bool matchName(const std::string& name, const std::string& pattern) {
+	if (!pattern.empty() && pattern.back() == '*')
+		return name.compare(0, pattern.size() - 1, pattern, 0, pattern.size() - 1) == 0;
+	return name == pattern;
+}
+
+
+struct Instance {
+	struct Source {
+		int inputId;
+		Signal signal;
+		std::vector<float> block;
+	};
+
+	Model* model;
+	Module* module;
+	float sampleRate = 0.f;
+	int64_t frame = 0;
+	std::vector<Source> sources;
+	int blockFrames = 0;
+
+	Instance(const std::string& slug, float sampleRate = 44100.f) {
+		model = findModel(slug);
+		module = model->createModule();
+		module->onAdd(Module::AddEvent());
+		setSampleRate(sampleRate);
+	}
+
+	~Instance() {
+		module->onRemove(Module::RemoveEvent());
+		delete module;
+	}
+
+	void setSampleRate(float sampleRate) {
+		this->sampleRate = sampleRate;
+		APP->engine->sampleRate = sampleRate;
+		Module::SampleRateChangeEvent e;
+		e.sampleRate = sampleRate;
+		e.sampleTime = 1.f / sampleRate;
+		module->onSampleRateChange(e);
+	}
+
+	template <typename TInfo>
+	std::vector<int> find(const std::vector<TInfo*>& infos, const std::string& pattern, const char* what) {
+		std::vector<int> ids;
+		for (size_t i = 0; i < infos.size(); i++) {
+			if (infos[i] && matchName(infos[i]->name, pattern))
+				ids.push_back(i);
+		}
+		if (ids.empty())
+			throw std::runtime_error(model->slug + " has no " + what + " named \"" + pattern + "\"");
+		return ids;
+	}
+
+	std::vector<int> findInputs(const std::string& pattern) {return find(module->inputInfos, pattern, "input");}
+	std::vector<int> findOutputs(const std::string& pattern) {return find(module->outputInfos, pattern, "output");}
+	std::vector<int> findParams(const std::string& pattern) {return find(module->paramQuantities, pattern, "param");}
+
+	void setParam(const std::string& pattern, float value) {
+		for (int id : findParams(pattern))
+			module->params[id].setValue(value);
+	}
+
+	/** Loads {key: value} through dataFromJson(), like a patch that saved that module setting. Takes ownership of `value`. */
+	void setData(const std::string& key, json_t* value) {
+		json_t* rootJ = json_object();
+		json_object_set_new(rootJ, key.c_str(), value);
+		module->dataFromJson(rootJ);
+		json_decref(rootJ);
+	}
+
+	/** Loads the module's part of a patch through fromJson(), like Rack does when it opens one. Takes ownership. */
+	void load(json_t* rootJ) {
+		module->fromJson(rootJ);
+		json_decref(rootJ);
+	}
+
+	/** Saves the module's part of a patch with toJson() and loads it back without its "data", like a patch saved
+	before the module had any settings to save
+	*/
+	void loadWithoutData() {
+		json_t* rootJ = module->toJson();
+		json_object_del(rootJ, "data");
+		load(rootJ);
+	}
+
+	/** Marks an input as patched with `channels` channels, without feeding it */
+	void plugInput(int inputId, int channels = 1) {
+		Module::PortChangeEvent e;
+		e.connecting = true;
+		e.type = Port::INPUT;
+		e.portId = inputId;
+		module->inputs[inputId].channels = channels;
+		module->onPortChange(e);
+	}
+
+	void connectInput(int inputId, Signal signal, int channels = 1) {
+		plugInput(inputId, channels);
+		Source source;
+		source.inputId = inputId;
+		source.signal = signal;
+		sources.push_back(source);
+	}
+
+	void connectInput(const std::string& pattern, Signal signal, int channels = 1) {
+		for (int id : findInputs(pattern))
+			connectInput(id, signal, channels);
+	}
+
+	void connectOutput(int outputId) {
+		Module::PortChangeEvent e;
+		e.connecting = true;
+		e.type = Port::OUTPUT;
+		e.portId = outputId;
+		// Rack marks a patched output as mono until the module sets its channel count
+		module->outputs[outputId].channels = 1;
+		module->onPortChange(e);
+	}
+
+	void connectOutput(const std::string& pattern) {
+		for (int id : findOutputs(pattern))
+			connectOutput(id);
+	}
+
+	/** Renders `frames` frames of every source signal ahead of time, so generating them isn't timed. */
+	void fill(int frames) {
+		float sampleTime = 1.f / sampleRate;
+		for (Source& source : sources) {
+			int channels = module->inputs[source.inputId].channels;
+			source.block.resize(frames * channels);
+			for (int i = 0; i < frames; i++) {
+				float v = source.signal.next(sampleTime);
+				for (int c = 0; c < channels; c++)
+					source.block[i * channels + c] = v;
+			}
+		}
+		blockFrames = frames;
+	}
+
+	/** Processes frame `i` of the block prepared by fill(), copying inputs in first like the engine does for cables. */
+	void processFrame(int i) {
+		for (Source& source : sources) {
+			Input& input = module->inputs[source.inputId];
+			std::memcpy(input.voltages, &source.block[i * input.channels], input.channels * sizeof(float));
+		}
+		Module::ProcessArgs args;
+		args.sampleRate = sampleRate;
+		args.sampleTime = 1.f / sampleRate;
+		args.frame = frame++;
+		module->process(args);
+	}
+
+	/** Processes the block prepared by fill() */
+	void run() {
+		for (int i = 0; i < blockFrames; i++)
+			processFrame(i);
+	}
+
+	void step(int frames = 1) {
+		fill(frames);
+		run();
+	}
+
+	float getOutput(const std::string& name, int channel = 0) {
+		return module->outputs[findOutputs(name).front()].getVoltage(channel);
+	}
+};
+
+
+/** Modules placed side by side, left to right, like a row in the rack. Neighbours talk through expander messages,
+which are flipped after every frame as the engine does, and cables carry outputs to inputs one frame later.
+*/
+struct Row {
+	struct Cable {
+		Instance* from;
+		int outputId;
+		Instance* to;
+		int inputId;
+	};
+
+	std::vector<Instance*> instances;
+	std::vector<Cable> cables;
+	float sampleRate;
+	int blockFrames = 0;
+
+	Row(float sampleRate = 44100.f) : sampleRate(sampleRate) {}
+
+	~Row() {
+		for (Instance* instance : instances)
+			delete instance;
+	}
+
+	Instance& add(const std::string& slug) {
+		Instance* instance = new Instance(slug, sampleRate);
+		if (!instances.empty()) {
+			Module* left = instances.back()->module;
+			left->rightExpander.module = instance->module;
+			instance->module->leftExpander.module = left;
+			Module::ExpanderChangeEvent e;
+			e.side = 1;
+			left->onExpanderChange(e);
+			e.side = 0;
+			instance->module->onExpanderChange(e);
+		}
+		instances.push_back(instance);
+		return *instance;
+	}
+
+	Instance& operator[](size_t i) {
+		return *instances[i];
+	}
+
+	/** Patches a cable between two modules of the row */
+	void connect(Instance& from, int outputId, Instance& to, int inputId) {
+		from.connectOutput(outputId);
+		to.plugInput(inputId);
+		cables.push_back(Cable{&from, outputId, &to, inputId});
+	}
+
+	void fill(int frames) {
+		for (Instance* instance : instances)
+			instance->fill(frames);
+		blockFrames = frames;
+	}
+
+	/** Processes frame `i` of the block prepared by fill() in every module, then flips the expander messages and
+	steps the cables
+	*/
+	void processFrame(int i) {
+		for (Instance* instance : instances)
+			instance->processFrame(i);
+		for (Instance* instance : instances) {
+			flip(instance->module->leftExpander);
+			flip(instance->module->rightExpander);
+		}
+		for (const Cable& cable : cables) {
+			Output& output = cable.from->module->outputs[cable.outputId];
+			Input& input = cable.to->module->inputs[cable.inputId];
+			int channels = std::max<int>(output.channels, 1);
+			if (channels != input.channels) {
+				// Rack doesn't announce channel count changes. There's no UI thread here to pick them up though,
+				// so modules hear about it through the port event, where they may resize their buffers.
+				cable.to->plugInput(cable.inputId, channels);
+			}
+			std::memcpy(input.voltages, output.voltages, channels * sizeof(float));
+		}
+	}
+
+	void run() {
+		for (int i = 0; i < blockFrames; i++)
+			processFrame(i);
+	}
+
+	void step(int frames = 1) {
+		fill(frames);
+		run();
+	}
+
+	static void flip(Module::Expander& expander) {
+		if (!expander.messageFlipRequested)
+			return;
+		std::swap(expander.producerMessage, expander.consumerMessage);
+		expander.messageFlipRequested = false;
+	}
+};
+
+
+/** Output channels of modules, read after every frame in a fixed order, for renders */
+struct Capture {
+	struct Channel {
+		Output* output;
+		int channel;
+		std::string name;
+	};
+	std::vector<Channel> channels;
+
+	/** Adds every channel of an output. Call after the first frame, once modules have set their channel counts. */
+	void add(Instance& instance, int outputId) {
+		Output& output = instance.module->outputs[outputId];
+		int n = std::max(output.getChannels(), 1);
+		for (int c = 0; c < n; c++) {
+			std::string name = instance.model->slug + " " + instance.module->outputInfos[outputId]->name;
+			if (n > 1)
+				name += string::f(" ch %d", c + 1);
+			channels.push_back(Channel{&output, c, name});
+		}
+	}
+
+	/** Adds every patched output of the row */
+	void addAll(Row& row) {
+		for (Instance* instance : row.instances) {
+			for (size_t i = 0; i < instance->module->outputs.size(); i++) {
+				if (instance->module->outputs[i].isConnected())
+					add(*instance, i);
+			}
+		}
+	}
+
+	void read(float* frame) const {
+		for (size_t i = 0; i < channels.size(); i++)
+			frame[i] = channels[i].output->getVoltage(channels[i].channel);
+	}
+
+	void append(std::vector<float>& samples) const {
+		for (const Channel& ch : channels)
+			samples.push_back(ch.output->getVoltage(ch.channel));
+	}
+};
+
+
+} // namespace headless
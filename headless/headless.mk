@@ -0,0 +1,58 @@
+# Headless tools, built against the Rack API stub in headless/rack.hpp instead of the Rack SDK.
+# `make bench` builds every module with the plugin's compiler flags and runs the process() benchmarks.
+# Pass arguments with BENCH_ARGS, e.g. `make bench BENCH_ARGS="-t 1 Distroi"`.
+# `make golden-record` renders every module to WAV files in GOLDEN_DIR (the checked-in golden/ by default), and
+# `make golden-check` renders again and compares against them.
+# Pass arguments with GOLDEN_ARGS, e.g. `make golden-check GOLDEN_ARGS="-e 1e-3 BaBum"`.
+# `make math-check` checks the error bounds of the approximations in src/ondas_math.hpp against libm and times them.
+# `make render` renders the chains of a patch description to WAV files in RENDER_DIR, e.g.
+# `make render RENDER_ARGS="-j 0 -t 600 headless/examples/drums.json"`.
+
+HEADLESS_BUILD := build/headless
+
+HEADLESS_FLAGS := -std=c++11 -O3 -funsafe-math-optimizations -fno-omit-frame-pointer -march=nehalem
+HEADLESS_FLAGS += -Wall -Wextra -Wno-unused-parameter
+HEADLESS_FLAGS += -DARCH_X64 -DARCH_LIN
+HEADLESS_FLAGS += -Iheadless -Isrc
+
+HEADLESS_OBJECTS := $(patsubst src/%.cpp,$(HEADLESS_BUILD)/%.o,$(wildcard src/*.cpp))
+HEADLESS_DEPS := headless/rack.hpp $(wildcard src/*.hpp)
+
+$(HEADLESS_BUILD)/%.o: src/%.cpp $(HEADLESS_DEPS)
+	@mkdir -p $(@D)
+	$(CXX) $(HEADLESS_FLAGS) -c $< -o $@
+
+$(HEADLESS_BUILD)/bench: headless/bench.cpp headless/harness.hpp $(HEADLESS_OBJECTS)
+	$(CXX) $(HEADLESS_FLAGS) headless/bench.cpp $(HEADLESS_OBJECTS) -o $@
+
+bench: $(HEADLESS_BUILD)/bench
+	$(HEADLESS_BUILD)/bench $(BENCH_ARGS)
+
+GOLDEN_DIR ?= golden
+
+$(HEADLESS_BUILD)/golden: headless/golden.cpp headless/harness.hpp headless/wav.hpp $(HEADLESS_OBJECTS)
+	$(CXX) $(HEADLESS_FLAGS) headless/golden.cpp $(HEADLESS_OBJECTS) -o $@
+
+golden-record: $(HEADLESS_BUILD)/golden
+	$(HEADLESS_BUILD)/golden record -d $(GOLDEN_DIR) $(GOLDEN_ARGS)
+
+golden-check: $(HEADLESS_BUILD)/golden
+	$(HEADLESS_BUILD)/golden check -d $(GOLDEN_DIR) $(GOLDEN_ARGS)
+
+RENDER_DIR ?= renders
+RENDER_ARGS ?= headless/examples/drums.json
+
+$(HEADLESS_BUILD)/render: headless/render.cpp headless/harness.hpp headless/wav.hpp $(HEADLESS_OBJECTS)
+	$(CXX) $(HEADLESS_FLAGS) -pthread headless/render.cpp $(HEADLESS_OBJECTS) -o $@
+
+render: $(HEADLESS_BUILD)/render
+	$(HEADLESS_BUILD)/render -o $(RENDER_DIR) $(RENDER_ARGS)
+
+$(HEADLESS_BUILD)/math: headless/math.cpp $(HEADLESS_DEPS)
+	@mkdir -p $(@D)
+	$(CXX) $(HEADLESS_FLAGS) headless/math.cpp -o $@
+
+math-check: $(HEADLESS_BUILD)/math
+	$(HEADLESS_BUILD)/math $(MATH_ARGS)
+
+.PHONY: bench golden-record golden-check render math-check
@@ -0,0 +1,158 @@
+// Accuracy and speed of the approximations in src/ondas_math.hpp.
+//
+// Each function is compared against libm in double precision over a range wider than Ondas uses it on, for both the
+// float and the simd::float_4 version, and fails if its error goes past the bound given in its doc comment or the two
+// versions disagree. Then the float libm function, the float approximation and the float_4 approximation are timed on
+// the same inputs, in ns per value.
+//
+// Usage: math [-t seconds]
+#include "plugin.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+
+/** Inputs spread evenly over [from, to], or evenly in log2 for `logScale` */
+static std::vector<float> inputs(float from, float to, bool logScale, int count) {
+	std::vector<float> x(count);
+	for (int i = 0; i < count; i++) {
+		double t = double(i) / (count - 1);
+		x[i] = logScale ? std::exp2(std::log2(from) + t * (std::log2(to) - std::log2(from))) : from + t * (to - from);
+	}
+	return x;
+}
+
+
+/** ns per value of f over `x`, best of three runs of about `seconds` in total */
+template <typename F>
+static double timeLoop(const std::vector<float>& x, float seconds, F f) {
+	double best = INFINITY;
+	for (int r = 0; r < 3; r++) {
+		int64_t values = 0;
+		float sink = 0.f;
+		auto start = std::chrono::steady_clock::now();
+		double elapsed = 0.0;
+		while (elapsed < seconds / 3) {
+			sink += f(x);
+			values += x.size();
+			elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		// Keeps the results alive, so the compiler can't drop the loop
+		if (sink == 12345.f)
+			std::printf(" ");
+		best = std::min(best, elapsed * 1e9 / values);
+	}
+	return best;
+}
+
+
+/** Checks and times one function. The error is divided by the larger of |reference| and `scale`: 0 for relative
+error, 1 for absolute error on results up to 1 and relative beyond. Returns false if it's out of bounds.
+*/
+template <typename TReference, typename TLibm, typename TFast, typename TFast4>
+static bool check(const char* name, float from, float to, bool logScale, double scale, double bound, float seconds, TReference reference, TLibm libm, TFast fast, TFast4 fast4) {
+	std::vector<float> x = inputs(from, to, logScale, 1 << 20);
+	double worst = 0.0;
+	float worstX = 0.f;
+	bool lanesMatch = true;
+	for (size_t i = 0; i + 4 <= x.size(); i += 4) {
+		simd::float_4 y4 = fast4(simd::float_4::load(&x[i]));
+		for (int l = 0; l < 4; l++) {
+			float y = fast(x[i + l]);
+			if (y != y4[l])
+				lanesMatch = false;
+			double r = reference(double(x[i + l]));
+			double error = std::fabs(y - r) / std::max(std::fabs(r), scale);
+			if (!(error <= worst)) {
+				worst = error;
+				worstX = x[i + l];
+			}
+		}
+	}
+	bool pass = worst <= bound && lanesMatch;
+
+	std::vector<float> block(x.begin(), x.begin() + 4096);
+	// Spread the timed inputs over the whole range too
+	for (size_t i = 0; i < block.size(); i++)
+		block[i] = x[i * (x.size() / block.size())];
+	double libmNs = timeLoop(block, seconds, [&](const std::vector<float>& v) {
+		float sum = 0.f;
+		for (float xi : v)
+			sum += libm(xi);
+		return sum;
+	});
+	double fastNs = timeLoop(block, seconds, [&](const std::vector<float>& v) {
+		float sum = 0.f;
+		for (float xi : v)
+			sum += fast(xi);
+		return sum;
+	});
+	double fast4Ns = timeLoop(block, seconds, [&](const std::vector<float>& v) {
+		simd::float_4 sum = 0.f;
+		for (size_t i = 0; i < v.size(); i += 4)
+			sum += fast4(simd::float_4::load(&v[i]));
+		return sum[0] + sum[1] + sum[2] + sum[3];
+	});
+
+	std::string range = string::f("[%g, %g]", from, to);
+	std::printf("%-12s %-16s %10.3g %10.3g %5s %9.2f %9.2f %11.2f\n", name, range.c_str(), worst, bound, pass ? "pass" : "FAIL", libmNs, fastNs, fast4Ns);
+	if (!lanesMatch)
+		std::printf("             float and float_4 results differ\n");
+	else if (!pass)
+		std::printf("             worst at x = %.9g\n", worstX);
+	std::fflush(stdout);
+	return pass;
+}
+
+
+int main(int argc, char** argv) {
+	float seconds = 0.3f;
+	for (int i = 1; i < argc; i++) {
+		if (!std::strcmp(argv[i], "-t") && i + 1 < argc) {
+			seconds = std::atof(argv[++i]);
+		}
+		else {
+			std::printf("Usage: %s [-t seconds]\n", argv[0]);
+			return !std::strcmp(argv[i], "-h") || !std::strcmp(argv[i], "--help") ? 0 : 2;
+		}
+	}
+
+	std::printf("%-12s %-16s %10s %10s %5s %9s %9s %11s\n", "function", "range", "error", "bound", "", "libm ns", "float ns", "float_4 ns");
+	int failures = 0;
+	failures += !check("exp2", -20.f, 20.f, false, 0.0, 3e-7, seconds,
+		[](double x) {return std::exp2(x);},
+		[](float x) {return std::exp2(x);},
+		[](float x) {return fastmath::exp2(x);},
+		[](simd::float_4 x) {return fastmath::exp2(x);});
+	failures += !check("log2", 1e-6f, 1e6f, true, 1.0, 2e-7, seconds,
+		[](double x) {return std::log2(x);},
+		[](float x) {return std::log2(x);},
+		[](float x) {return fastmath::log2(x);},
+		[](simd::float_4 x) {return fastmath::log2(x);});
+	// x^1.5, the kind of curve the modules bend ramps and knobs with
+	failures += !check("pow(x, 1.5)", 1e-3f, 1e3f, true, 0.0, 2e-6, seconds,
+		[](double x) {return std::pow(x, 1.5);},
+		[](float x) {return std::pow(x, 1.5f);},
+		[](float x) {return fastmath::pow(x, 1.5f);},
+		[](simd::float_4 x) {return fastmath::pow(x, simd::float_4(1.5f));});
+	failures += !check("tanh", -10.f, 10.f, false, 1.0, 3e-7, seconds,
+		[](double x) {return std::tanh(x);},
+		[](float x) {return std::tanh(x);},
+		[](float x) {return fastmath::tanh(x);},
+		[](simd::float_4 x) {return fastmath::tanh(x);});
+	failures += !check("sin2pi", -4.f, 4.f, false, 1.0, 4e-6, seconds,
+		[](double x) {return std::sin(2.0 * M_PI * x);},
+		[](float x) {return std::sin(2.f * float(M_PI) * x);},
+		[](float x) {return fastmath::sin2pi(x);},
+		[](simd::float_4 x) {return fastmath::sin2pi(x);});
+	failures += !check("cos2pi", -4.f, 4.f, false, 1.0, 4e-6, seconds,
+		[](double x) {return std::cos(2.0 * M_PI * x);},
+		[](float x) {return std::cos(2.f * float(M_PI) * x);},
+		[](float x) {return fastmath::cos2pi(x);},
+		[](simd::float_4 x) {return fastmath::cos2pi(x);});
+
+	if (failures)
+		std::printf("%d function(s) out of bounds\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,2236 @@
+#pragma once
+// Headless stand-in for the Rack SDK.
+//
+// This header mirrors the subset of the Rack v2 API used by Ondas closely enough that the module sources in src/
+// compile unchanged against it, so their process() code can be driven outside of Rack (see headless/bench.cpp).
+// The engine types (ports, params, lights, expanders, dsp and simd helpers) behave like Rack's. Everything on the
+// UI side (widgets, NanoVG, windows, menus) is a compile-only shell: it exists so ModuleWidget code builds, but
+// nothing is ever drawn.
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdarg>
+#include <cctype>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <smmintrin.h>
+#include <sys/stat.h>
+
+
+#define DEPRECATED
+#define PRIVATE
+
+// GLFW input constants, for event handlers
+#define GLFW_RELEASE 0
+#define GLFW_PRESS 1
+#define GLFW_MOUSE_BUTTON_LEFT 0
+#define GLFW_MOUSE_BUTTON_RIGHT 1
+#define ENUMS(name, count) name, name ## _LAST = name + (count) - 1
+#define LENGTHOF(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define CHECKMARK_STRING "✔"
+#define CHECKMARK(_cond) ((_cond) ? CHECKMARK_STRING : "")
+#define RIGHT_ARROW "▸"
+
+#define DEBUG(format, ...) rack::logger::log("debug", __FILE__, __LINE__, format, ##__VA_ARGS__)
+#define INFO(format, ...) rack::logger::log("info", __FILE__, __LINE__, format, ##__VA_ARGS__)
+#define WARN(format, ...) rack::logger::log("warn", __FILE__, __LINE__, format, ##__VA_ARGS__)
+#define FATAL(format, ...) rack::logger::log("fatal", __FILE__, __LINE__, format, ##__VA_ARGS__)
+
+
+////////////////////
+// jansson
+////////////////////
+
+typedef long long json_int_t;
+
+enum json_type {
+	JSON_OBJECT,
+	JSON_ARRAY,
+	JSON_STRING,
+	JSON_INTEGER,
+	JSON_REAL,
+	JSON_TRUE,
+	JSON_FALSE,
+	JSON_NULL
+};
+
+struct json_t {
+	json_type type;
+	int refcount = 1;
+	json_int_t integer = 0;
+	double real = 0.0;
+	std::string string;
+	std::vector<std::pair<std::string, json_t*>> object;
+	std::vector<json_t*> array;
+
+	explicit json_t(json_type type) : type(type) {}
+	~json_t();
+};
+
+inline void json_decref(json_t* json) {
+	if (json && --json->refcount == 0)
+		delete json;
+}
+
+inline json_t* json_incref(json_t* json) {
+	if (json)
+		json->refcount++;
+	return json;
+}
+
+inline json_t::~json_t() {
+	for (auto& kv : object)
+		json_decref(kv.second);
+	for (json_t* j : array)
+		json_decref(j);
+}
+
+inline json_t* json_object() {return new json_t(JSON_OBJECT);}
+inline json_t* json_array() {return new json_t(JSON_ARRAY);}
+inline json_t* json_null() {return new json_t(JSON_NULL);}
+inline json_t* json_true() {return new json_t(JSON_TRUE);}
+inline json_t* json_false() {return new json_t(JSON_FALSE);}
+inline json_t* json_boolean(bool b) {return new json_t(b ? JSON_TRUE : JSON_FALSE);}
+
+inline json_t* json_integer(json_int_t i) {
+	json_t* j = new json_t(JSON_INTEGER);
+	j->integer = i;
+	return j;
+}
+
+inline json_t* json_real(double r) {
+	json_t* j = new json_t(JSON_REAL);
+	j->real = r;
+	return j;
+}
+
+inline json_t* json_string(const char* s) {
+	json_t* j = new json_t(JSON_STRING);
+	j->string = s;
+	return j;
+}
+
+inline int json_object_set_new(json_t* object, const char* key, json_t* value) {
+	if (!object || object->type != JSON_OBJECT || !value)
+		return -1;
+	for (auto& kv : object->object) {
+		if (kv.first == key) {
+			json_decref(kv.second);
+			kv.second = value;
+			return 0;
+		}
+	}
+	object->object.push_back(std::make_pair(std::string(key), value));
+	return 0;
+}
+
+inline json_t* json_object_get(const json_t* object, const char* key) {
+	if (!object || object->type != JSON_OBJECT)
+		return NULL;
+	for (auto& kv : object->object) {
+		if (kv.first == key)
+			return kv.second;
+	}
+	return NULL;
+}
+
+inline int json_array_append_new(json_t* array, json_t* value) {
+	if (!array || array->type != JSON_ARRAY || !value)
+		return -1;
+	array->array.push_back(value);
+	return 0;
+}
+
+inline size_t json_array_size(const json_t* array) {
+	return (array && array->type == JSON_ARRAY) ? array->array.size() : 0;
+}
+
+inline json_t* json_array_get(const json_t* array, size_t index) {
+	return (index < json_array_size(array)) ? array->array[index] : NULL;
+}
+
+inline json_int_t json_integer_value(const json_t* j) {return (j && j->type == JSON_INTEGER) ? j->integer : 0;}
+inline double json_real_value(const json_t* j) {return (j && j->type == JSON_REAL) ? j->real : 0.0;}
+inline double json_number_value(const json_t* j) {
+	if (!j)
+		return 0.0;
+	if (j->type == JSON_INTEGER)
+		return (double) j->integer;
+	if (j->type == JSON_REAL)
+		return j->real;
+	return 0.0;
+}
+inline const char* json_string_value(const json_t* j) {return (j && j->type == JSON_STRING) ? j->string.c_str() : NULL;}
+inline bool json_is_true(const json_t* j) {return j && j->type == JSON_TRUE;}
+inline bool json_boolean_value(const json_t* j) {return json_is_true(j);}
+inline bool json_is_object(const json_t* j) {return j && j->type == JSON_OBJECT;}
+inline bool json_is_array(const json_t* j) {return j && j->type == JSON_ARRAY;}
+inline bool json_is_integer(const json_t* j) {return j && j->type == JSON_INTEGER;}
+inline bool json_is_number(const json_t* j) {return j && (j->type == JSON_INTEGER || j->type == JSON_REAL);}
+
+#define json_array_foreach(array, index, value) \
+	for (index = 0; index < json_array_size(array) && (value = json_array_get(array, index)); index++)
+
+inline bool json_is_string(const json_t* j) {return j && j->type == JSON_STRING;}
+
+inline int json_object_del(json_t* object, const char* key) {
+	if (!object || object->type != JSON_OBJECT)
+		return -1;
+	for (auto it = object->object.begin(); it != object->object.end(); ++it) {
+		if (it->first == key) {
+			json_decref(it->second);
+			object->object.erase(it);
+			return 0;
+		}
+	}
+	return -1;
+}
+
+inline size_t json_object_size(const json_t* object) {
+	return (object && object->type == JSON_OBJECT) ? object->object.size() : 0;
+}
+
+// Iterates over keys in insertion order, like jansson since 2.8
+#define json_object_foreach(obj, key, value) \
+	for (size_t json_i_ = 0; json_i_ < json_object_size(obj) && ((key = (obj)->object[json_i_].first.c_str()), (value = (obj)->object[json_i_].second)); json_i_++)
+
+struct json_error_t {
+	int line = 0;
+	int column = 0;
+	char text[160] = {};
+};
+
+/** Recursive descent parser for json_loads() */
+struct JsonParser {
+	const char* p;
+	int line = 1;
+	const char* lineStart;
+	json_error_t* error;
+
+	JsonParser(const char* input, json_error_t* error) : p(input), lineStart(input), error(error) {}
+
+	json_t* fail(const char* message) {
+		if (error) {
+			error->line = line;
+			error->column = int(p - lineStart) + 1;
+			std::snprintf(error->text, sizeof(error->text), "%s", message);
+		}
+		return NULL;
+	}
+
+	void skipSpace() {
+		while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+			if (*p == '\n') {
+				line++;
+				lineStart = p + 1;
+			}
+			p++;
+		}
+	}
+
+	bool literal(const char* word) {
+		size_t n = std::strlen(word);
+		if (std::strncmp(p, word, n))
+			return false;
+		p += n;
+		return true;
+	}
+
+	bool parseString(std::string& out) {
+		p++; // Opening quote
+		while (*p != '"') {
+			if (!*p || *p == '\n')
+				return false;
+			if (*p == '\\') {
+				p++;
+				switch (*p) {
+					case 'n': out += '\n'; break;
+					case 't': out += '\t'; break;
+					case 'r': out += '\r'; break;
+					case 'b': out += '\b'; break;
+					case 'f': out += '\f'; break;
+					case 'u': {
+						unsigned code = 0;
+						for (int i = 1; i <= 4; i++) {
+							char c = p[i];
+							if (!std::isxdigit((unsigned char) c))
+								return false;
+							code = code * 16 + (std::isdigit((unsigned char) c) ? c - '0' : (std::tolower(c) - 'a' + 10));
+						}
+						p += 4;
+						// Basic multilingual plane only, as UTF-8
+						if (code < 0x80) {
+							out += char(code);
+						}
+						else if (code < 0x800) {
+							out += char(0xc0 | (code >> 6));
+							out += char(0x80 | (code & 0x3f));
+						}
+						else {
+							out += char(0xe0 | (code >> 12));
+							out += char(0x80 | ((code >> 6) & 0x3f));
+							out += char(0x80 | (code & 0x3f));
+						}
+					} break;
+					case '"': case '\\': case '/': out += *p; break;
+					default: return false;
+				}
+				p++;
+			}
+			else {
+				out += *p++;
+			}
+		}
+		p++;
+		return true;
+	}
+
+	json_t* parseValue(int depth) {
+		skipSpace();
+		if (depth > 64)
+			return fail("maximum nesting depth reached");
+		if (*p == '{') {
+			p++;
+			json_t* object = json_object();
+			skipSpace();
+			if (*p == '}') {
+				p++;
+				return object;
+			}
+			while (true) {
+				skipSpace();
+				std::string key;
+				if (*p != '"' || !parseString(key)) {
+					json_decref(object);
+					return fail("expected a string key");
+				}
+				skipSpace();
+				if (*p++ != ':') {
+					json_decref(object);
+					return fail("expected ':'");
+				}
+				json_t* value = parseValue(depth + 1);
+				if (!value) {
+					json_decref(object);
+					return NULL;
+				}
+				json_object_set_new(object, key.c_str(), value);
+				skipSpace();
+				if (*p == ',') {
+					p++;
+					continue;
+				}
+				if (*p == '}') {
+					p++;
+					return object;
+				}
+				json_decref(object);
+				return fail("expected ',' or '}'");
+			}
+		}
+		if (*p == '[') {
+			p++;
+			json_t* array = json_array();
+			skipSpace();
+			if (*p == ']') {
+				p++;
+				return array;
+			}
+			while (true) {
+				json_t* value = parseValue(depth + 1);
+				if (!value) {
+					json_decref(array);
+					return NULL;
+				}
+				json_array_append_new(array, value);
+				skipSpace();
+				if (*p == ',') {
+					p++;
+					continue;
+				}
+				if (*p == ']') {
+					p++;
+					return array;
+				}
+				json_decref(array);
+				return fail("expected ',' or ']'");
+			}
+		}
+		if (*p == '"') {
+			std::string string;
+			if (!parseString(string))
+				return fail("invalid string");
+			json_t* j = new json_t(JSON_STRING);
+			j->string = string;
+			return j;
+		}
+		if (literal("true"))
+			return json_true();
+		if (literal("false"))
+			return json_false();
+		if (literal("null"))
+			return json_null();
+		if (*p == '-' || std::isdigit((unsigned char) *p)) {
+			const char* start = p;
+			if (*p == '-')
+				p++;
+			while (std::isdigit((unsigned char) *p))
+				p++;
+			bool real = false;
+			if (*p == '.' || *p == 'e' || *p == 'E') {
+				real = true;
+				if (*p == '.')
+					p++;
+				while (std::isdigit((unsigned char) *p))
+					p++;
+				if (*p == 'e' || *p == 'E') {
+					p++;
+					if (*p == '+' || *p == '-')
+						p++;
+					while (std::isdigit((unsigned char) *p))
+						p++;
+				}
+			}
+			std::string number(start, p);
+			return real ? json_real(std::strtod(number.c_str(), NULL)) : json_integer(std::strtoll(number.c_str(), NULL, 10));
+		}
+		return fail("invalid token");
+	}
+
+	json_t* parse() {
+		json_t* root = parseValue(0);
+		if (!root)
+			return NULL;
+		skipSpace();
+		if (*p) {
+			json_decref(root);
+			return fail("end of file expected");
+		}
+		return root;
+	}
+};
+
+inline json_t* json_loads(const char* input, size_t flags, json_error_t* error) {
+	return JsonParser(input, error).parse();
+}
+
+inline json_t* json_load_file(const char* path, size_t flags, json_error_t* error) {
+	FILE* file = std::fopen(path, "rb");
+	if (!file) {
+		if (error)
+			std::snprintf(error->text, sizeof(error->text), "unable to open %s", path);
+		return NULL;
+	}
+	std::string text;
+	char buffer[4096];
+	size_t n;
+	while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+		text.append(buffer, n);
+	std::fclose(file);
+	return json_loads(text.c_str(), flags, error);
+}
+
+
+////////////////////
+// nanovg
+////////////////////
+
+struct NVGcontext;
+struct NVGLUframebuffer;
+
+struct NVGcolor {
+	float r, g, b, a;
+};
+
+struct NVGpaint {
+	NVGcolor innerColor;
+	NVGcolor outerColor;
+};
+
+enum NVGalign {
+	NVG_ALIGN_LEFT = 1 << 0,
+	NVG_ALIGN_CENTER = 1 << 1,
+	NVG_ALIGN_RIGHT = 1 << 2,
+	NVG_ALIGN_TOP = 1 << 3,
+	NVG_ALIGN_MIDDLE = 1 << 4,
+	NVG_ALIGN_BOTTOM = 1 << 5,
+	NVG_ALIGN_BASELINE = 1 << 6,
+};
+
+inline NVGcolor nvgRGBAf(float r, float g, float b, float a) {return NVGcolor{r, g, b, a};}
+inline NVGcolor nvgRGBf(float r, float g, float b) {return nvgRGBAf(r, g, b, 1.f);}
+inline NVGcolor nvgRGBA(unsigned char r, unsigned char g, unsigned char b, unsigned char a) {return nvgRGBAf(r / 255.f, g / 255.f, b / 255.f, a / 255.f);}
+inline NVGcolor nvgRGB(unsigned char r, unsigned char g, unsigned char b) {return nvgRGBA(r, g, b, 255);}
+inline NVGcolor nvgTransRGBA(NVGcolor c, unsigned char a) {c.a = a / 255.f; return c;}
+
+inline void nvgSave(NVGcontext*) {}
+inline void nvgRestore(NVGcontext*) {}
+inline void nvgTranslate(NVGcontext*, float, float) {}
+inline void nvgScale(NVGcontext*, float, float) {}
+inline void nvgScissor(NVGcontext*, float, float, float, float) {}
+inline void nvgResetScissor(NVGcontext*) {}
+inline void nvgGlobalAlpha(NVGcontext*, float) {}
+inline void nvgBeginPath(NVGcontext*) {}
+inline void nvgClosePath(NVGcontext*) {}
+inline void nvgMoveTo(NVGcontext*, float, float) {}
+inline void nvgLineTo(NVGcontext*, float, float) {}
+inline void nvgRect(NVGcontext*, float, float, float, float) {}
+inline void nvgRoundedRect(NVGcontext*, float, float, float, float, float) {}
+inline void nvgCircle(NVGcontext*, float, float, float) {}
+inline void nvgFillColor(NVGcontext*, NVGcolor) {}
+inline void nvgFillPaint(NVGcontext*, NVGpaint) {}
+inline NVGpaint nvgLinearGradient(NVGcontext*, float, float, float, float, NVGcolor icol, NVGcolor ocol) {return NVGpaint{icol, ocol};}
+inline NVGpaint nvgRadialGradient(NVGcontext*, float, float, float, float, NVGcolor icol, NVGcolor ocol) {return NVGpaint{icol, ocol};}
+inline void nvgStrokeColor(NVGcontext*, NVGcolor) {}
+inline void nvgStrokeWidth(NVGcontext*, float) {}
+inline void nvgFill(NVGcontext*) {}
+inline void nvgStroke(NVGcontext*) {}
+inline void nvgFontSize(NVGcontext*, float) {}
+inline void nvgFontFaceId(NVGcontext*, int) {}
+inline void nvgTextAlign(NVGcontext*, int) {}
+inline void nvgTextLetterSpacing(NVGcontext*, float) {}
+inline float nvgText(NVGcontext*, float x, float, const char*, const char*) {return x;}
+inline float nvgTextBounds(NVGcontext*, float x, float y, const char*, const char*, float* bounds) {
+	if (bounds) {
+		bounds[0] = bounds[2] = x;
+		bounds[1] = bounds[3] = y;
+	}
+	return 0.f;
+}
+
+
+namespace rack {
+
+
+////////////////////
+// logger, string, system
+////////////////////
+
+namespace logger {
+
+inline void log(const char* level, const char* filename, int line, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	std::fprintf(stderr, "[%s %s:%d] ", level, filename, line);
+	std::vfprintf(stderr, format, args);
+	std::fprintf(stderr, "\n");
+	va_end(args);
+}
+
+} // namespace logger
+
+
+namespace string {
+
+inline std::string f(const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	va_list argsCopy;
+	va_copy(argsCopy, args);
+	int size = std::vsnprintf(NULL, 0, format, argsCopy);
+	va_end(argsCopy);
+	std::string s(size > 0 ? size : 0, '\0');
+	if (size > 0)
+		std::vsnprintf(&s[0], size + 1, format, args);
+	va_end(args);
+	return s;
+}
+
+} // namespace string
+
+
+namespace system {
+
+inline std::string join(const std::string& path1, const std::string& path2) {
+	if (path1.empty())
+		return path2;
+	return path1 + "/" + path2;
+}
+
+inline bool createDirectories(const std::string& path) {
+	for (size_t i = 1; i <= path.size(); i++) {
+		if (i == path.size() || path[i] == '/')
+			mkdir(path.substr(0, i).c_str(), 0755);
+	}
+	struct stat st;
+	return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+} // namespace system
+
+
+////////////////////
+// math
+////////////////////
+
+namespace math {
+
+inline int clamp(int x, int a, int b) {return std::max(std::min(x, b), a);}
+inline float clamp(float x, float a = 0.f, float b = 1.f) {return std::fmax(std::fmin(x, b), a);}
+inline float rescale(float x, float xMin, float xMax, float yMin, float yMax) {return yMin + (x - xMin) / (xMax - xMin) * (yMax - yMin);}
+inline float crossfade(float a, float b, float p) {return a + (b - a) * p;}
+inline bool isNear(float a, float b, float epsilon = 1e-6f) {return std::fabs(a - b) <= epsilon;}
+inline int eucMod(int a, int b) {
+	int mod = a % b;
+	if (mod < 0)
+		mod += b;
+	return mod;
+}
+inline bool isPow2(int n) {return n > 0 && (n & (n - 1)) == 0;}
+
+struct Vec {
+	float x = 0.f;
+	float y = 0.f;
+
+	Vec() {}
+	Vec(float xy) : x(xy), y(xy) {}
+	Vec(float x, float y) : x(x), y(y) {}
+
+	Vec neg() const {return Vec(-x, -y);}
+	Vec plus(Vec b) const {return Vec(x + b.x, y + b.y);}
+	Vec minus(Vec b) const {return Vec(x - b.x, y - b.y);}
+	Vec mult(float s) const {return Vec(x * s, y * s);}
+	Vec mult(Vec b) const {return Vec(x * b.x, y * b.y);}
+	Vec div(float s) const {return Vec(x / s, y / s);}
+	Vec div(Vec b) const {return Vec(x / b.x, y / b.y);}
+	bool equals(Vec b) const {return x == b.x && y == b.y;}
+	bool isZero() const {return x == 0.f && y == 0.f;}
+	Vec round() const {return Vec(std::round(x), std::round(y));}
+	Vec floor() const {return Vec(std::floor(x), std::floor(y));}
+};
+
+inline Vec operator+(const Vec& a, const Vec& b) {return a.plus(b);}
+inline Vec operator-(const Vec& a, const Vec& b) {return a.minus(b);}
+inline Vec operator*(const Vec& a, float b) {return a.mult(b);}
+inline Vec operator*(const Vec& a, const Vec& b) {return a.mult(b);}
+inline Vec operator/(const Vec& a, float b) {return a.div(b);}
+inline Vec operator-(const Vec& a) {return a.neg();}
+
+struct Rect {
+	Vec pos;
+	Vec size;
+
+	Rect() {}
+	Rect(Vec pos, Vec size) : pos(pos), size(size) {}
+	Rect(float posX, float posY, float sizeX, float sizeY) : pos(posX, posY), size(sizeX, sizeY) {}
+	static Rect fromMinMax(Vec a, Vec b) {return Rect(a, b.minus(a));}
+
+	bool contains(Vec v) const {
+		return (pos.x <= v.x) && (v.x < pos.x + size.x) && (pos.y <= v.y) && (v.y < pos.y + size.y);
+	}
+	bool intersects(Rect r) const {
+		return (r.pos.x + r.size.x > pos.x && r.pos.x < pos.x + size.x) && (r.pos.y + r.size.y > pos.y && r.pos.y < pos.y + size.y);
+	}
+	Vec getCenter() const {return pos.plus(size.mult(0.5f));}
+	Vec getTopLeft() const {return pos;}
+	Vec getBottomRight() const {return pos.plus(size);}
+	Rect grow(Vec delta) const {return Rect(pos.minus(delta), size.plus(delta.mult(2.f)));}
+	Rect zeroPos() const {return Rect(Vec(), size);}
+};
+
+} // namespace math
+
+
+////////////////////
+// simd
+////////////////////
+
+namespace simd {
+
+template <typename TYPE, int SIZE>
+struct Vector;
+
+template <>
+struct Vector<int32_t, 4>;
+
+template <>
+struct Vector<float, 4> {
+	using type = float;
+	constexpr static int size = 4;
+
+	union {
+		__m128 v;
+		float s[4];
+	};
+
+	Vector() = default;
+	Vector(__m128 v) : v(v) {}
+	Vector(float x) {v = _mm_set1_ps(x);}
+	Vector(float x1, float x2, float x3, float x4) {v = _mm_setr_ps(x1, x2, x3, x4);}
+	explicit Vector(Vector<int32_t, 4> a);
+
+	static Vector zero() {return Vector(_mm_setzero_ps());}
+	static Vector mask() {return Vector(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_setzero_si128(), _mm_setzero_si128())));}
+	static Vector load(const float* x) {return Vector(_mm_loadu_ps(x));}
+	static Vector cast(Vector<int32_t, 4> a);
+	void store(float* z) {_mm_storeu_ps(z, v);}
+	float& operator[](int i) {return s[i];}
+	const float& operator[](int i) const {return s[i];}
+};
+
+template <>
+struct Vector<int32_t, 4> {
+	using type = int32_t;
+	constexpr static int size = 4;
+
+	union {
+		__m128i v;
+		int32_t s[4];
+	};
+
+	Vector() = default;
+	Vector(__m128i v) : v(v) {}
+	Vector(int32_t x) {v = _mm_set1_epi32(x);}
+	Vector(int32_t x1, int32_t x2, int32_t x3, int32_t x4) {v = _mm_setr_epi32(x1, x2, x3, x4);}
+	explicit Vector(Vector<float, 4> a) {v = _mm_cvttps_epi32(a.v);}
+
+	static Vector zero() {return Vector(_mm_setzero_si128());}
+	static Vector mask() {return Vector(_mm_cmpeq_epi32(_mm_setzero_si128(), _mm_setzero_si128()));}
+	static Vector load(const int32_t* x) {return Vector(_mm_loadu_si128((const __m128i*) x));}
+	static Vector cast(Vector<float, 4> a) {return Vector(_mm_castps_si128(a.v));}
+	void store(int32_t* z) {_mm_storeu_si128((__m128i*) z, v);}
+	int32_t& operator[](int i) {return s[i];}
+	const int32_t& operator[](int i) const {return s[i];}
+};
+
+inline Vector<float, 4>::Vector(Vector<int32_t, 4> a) {v = _mm_cvtepi32_ps(a.v);}
+inline Vector<float, 4> Vector<float, 4>::cast(Vector<int32_t, 4> a) {return Vector(_mm_castsi128_ps(a.v));}
+
+typedef Vector<float, 4> float_4;
+typedef Vector<int32_t, 4> int32_4;
+
+inline float_4 operator+(const float_4& a, const float_4& b) {return float_4(_mm_add_ps(a.v, b.v));}
+inline float_4 operator-(const float_4& a, const float_4& b) {return float_4(_mm_sub_ps(a.v, b.v));}
+inline float_4 operator*(const float_4& a, const float_4& b) {return float_4(_mm_mul_ps(a.v, b.v));}
+inline float_4 operator/(const float_4& a, const float_4& b) {return float_4(_mm_div_ps(a.v, b.v));}
+inline float_4 operator&(const float_4& a, const float_4& b) {return float_4(_mm_and_ps(a.v, b.v));}
+inline float_4 operator|(const float_4& a, const float_4& b) {return float_4(_mm_or_ps(a.v, b.v));}
+inline float_4 operator^(const float_4& a, const float_4& b) {return float_4(_mm_xor_ps(a.v, b.v));}
+inline float_4 operator==(const float_4& a, const float_4& b) {return float_4(_mm_cmpeq_ps(a.v, b.v));}
+inline float_4 operator!=(const float_4& a, const float_4& b) {return float_4(_mm_cmpneq_ps(a.v, b.v));}
+inline float_4 operator<(const float_4& a, const float_4& b) {return float_4(_mm_cmplt_ps(a.v, b.v));}
+inline float_4 operator>(const float_4& a, const float_4& b) {return float_4(_mm_cmpgt_ps(a.v, b.v));}
+inline float_4 operator<=(const float_4& a, const float_4& b) {return float_4(_mm_cmple_ps(a.v, b.v));}
+inline float_4 operator>=(const float_4& a, const float_4& b) {return float_4(_mm_cmpge_ps(a.v, b.v));}
+inline float_4 operator-(const float_4& a) {return 0.f - a;}
+inline float_4 operator+(const float_4& a) {return a;}
+inline float_4 operator~(const float_4& a) {return a ^ float_4::mask();}
+inline float_4& operator+=(float_4& a, const float_4& b) {return a = a + b;}
+inline float_4& operator-=(float_4& a, const float_4& b) {return a = a - b;}
+inline float_4& operator*=(float_4& a, const float_4& b) {return a = a * b;}
+inline float_4& operator/=(float_4& a, const float_4& b) {return a = a / b;}
+inline float_4& operator&=(float_4& a, const float_4& b) {return a = a & b;}
+inline float_4& operator|=(float_4& a, const float_4& b) {return a = a | b;}
+inline float_4& operator^=(float_4& a, const float_4& b) {return a = a ^ b;}
+
+inline int32_4 operator+(const int32_4& a, const int32_4& b) {return int32_4(_mm_add_epi32(a.v, b.v));}
+inline int32_4 operator-(const int32_4& a, const int32_4& b) {return int32_4(_mm_sub_epi32(a.v, b.v));}
+inline int32_4 operator*(const int32_4& a, const int32_4& b) {return int32_4(_mm_mullo_epi32(a.v, b.v));}
+inline int32_4 operator&(const int32_4& a, const int32_4& b) {return int32_4(_mm_and_si128(a.v, b.v));}
+inline int32_4 operator|(const int32_4& a, const int32_4& b) {return int32_4(_mm_or_si128(a.v, b.v));}
+inline int32_4 operator^(const int32_4& a, const int32_4& b) {return int32_4(_mm_xor_si128(a.v, b.v));}
+inline int32_4 operator==(const int32_4& a, const int32_4& b) {return int32_4(_mm_cmpeq_epi32(a.v, b.v));}
+inline int32_4 operator<(const int32_4& a, const int32_4& b) {return int32_4(_mm_cmplt_epi32(a.v, b.v));}
+inline int32_4 operator>(const int32_4& a, const int32_4& b) {return int32_4(_mm_cmpgt_epi32(a.v, b.v));}
+inline int32_4 operator<<(const int32_4& a, const int& b) {return int32_4(_mm_sll_epi32(a.v, _mm_cvtsi32_si128(b)));}
+inline int32_4 operator>>(const int32_4& a, const int& b) {return int32_4(_mm_sra_epi32(a.v, _mm_cvtsi32_si128(b)));}
+inline int32_4 operator~(const int32_4& a) {return a ^ int32_4::mask();}
+inline int32_4& operator+=(int32_4& a, const int32_4& b) {return a = a + b;}
+inline int32_4& operator-=(int32_4& a, const int32_4& b) {return a = a - b;}
+inline int32_4& operator&=(int32_4& a, const int32_4& b) {return a = a & b;}
+inline int32_4& operator|=(int32_4& a, const int32_4& b) {return a = a | b;}
+
+// Standard math functions for scalars
+using std::fmax;
+using std::fmin;
+using std::fabs;
+using std::sqrt;
+using std::floor;
+using std::ceil;
+using std::trunc;
+using std::round;
+using std::fmod;
+using std::exp;
+using std::log;
+using std::sin;
+using std::cos;
+using std::pow;
+
+inline float ifelse(bool cond, float a, float b) {return cond ? a : b;}
+inline float_4 ifelse(float_4 mask, float_4 a, float_4 b) {return float_4(_mm_blendv_ps(b.v, a.v, mask.v));}
+inline int movemask(float_4 a) {return _mm_movemask_ps(a.v);}
+inline int movemask(int32_4 a) {return _mm_movemask_ps(_mm_castsi128_ps(a.v));}
+
+inline float_4 fmax(float_4 a, float_4 b) {return float_4(_mm_max_ps(a.v, b.v));}
+inline float_4 fmin(float_4 a, float_4 b) {return float_4(_mm_min_ps(a.v, b.v));}
+inline float_4 clamp(float_4 x, float_4 a = 0.f, float_4 b = 1.f) {return fmin(fmax(x, a), b);}
+inline float clamp(float x, float a = 0.f, float b = 1.f) {return std::fmin(std::fmax(x, a), b);}
+inline float_4 abs(float_4 a) {return float_4(_mm_andnot_ps(_mm_set1_ps(-0.f), a.v));}
+inline float_4 sqrt(float_4 a) {return float_4(_mm_sqrt_ps(a.v));}
+inline float_4 rsqrt(float_4 a) {return float_4(_mm_rsqrt_ps(a.v));}
+inline float_4 rcp(float_4 a) {return float_4(_mm_rcp_ps(a.v));}
+inline float_4 floor(float_4 a) {return float_4(_mm_floor_ps(a.v));}
+inline float_4 ceil(float_4 a) {return float_4(_mm_ceil_ps(a.v));}
+inline float_4 trunc(float_4 a) {return float_4(_mm_round_ps(a.v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC));}
+inline float_4 round(float_4 a) {
+	// Round half away from zero, like std::round()
+	float_4 t = trunc(a);
+	return t + ifelse(abs(a - t) >= 0.5f, ifelse(a < 0.f, -1.f, 1.f), 0.f);
+}
+inline float_4 fmod(float_4 a, float_4 b) {return a - trunc(a / b) * b;}
+inline float crossfade(float a, float b, float p) {return a + (b - a) * p;}
+inline float_4 crossfade(float_4 a, float_4 b, float_4 p) {return a + (b - a) * p;}
+
+// Cephes polynomial exp and log, the same approximations as the sse_mathfun functions Rack uses
+inline float_4 exp(float_4 x) {
+	x = clamp(x, -88.3762626647949f, 88.3762626647949f);
+	// Express exp(x) as 2^n * exp(g), |g| <= 0.5 ln 2
+	float_4 fx = floor(x * 1.44269504088896341f + 0.5f);
+	x = x - fx * 0.693359375f - fx * -2.12194440e-4f;
+	float_4 z = x * x;
+	float_4 y = 1.9875691500e-4f;
+	y = y * x + 1.3981999507e-3f;
+	y = y * x + 8.3334519073e-3f;
+	y = y * x + 4.1665795894e-2f;
+	y = y * x + 1.6666665459e-1f;
+	y = y * x + 5.0000001201e-1f;
+	y = y * z + x + 1.f;
+	int32_4 n = int32_4(fx) + 0x7f;
+	return y * float_4::cast(n << 23);
+}
+
+inline float_4 log(float_4 x) {
+	float_4 invalid = (x <= 0.f);
+	x = fmax(x, float_4::cast(int32_4(0x00800000)));
+	int32_4 e = int32_4(_mm_srli_epi32(_mm_castps_si128(x.v), 23)) - 0x7f;
+	// Keep the mantissa in [0.5, 1)
+	x = (x & float_4::cast(int32_4(~0x7f800000))) | 0.5f;
+	float_4 fe = float_4(e) + 1.f;
+	float_4 mask = (x < 0.707106781186547524f);
+	float_4 tmp = x & mask;
+	x = x - 1.f;
+	fe = fe - (mask & 1.f);
+	x = x + tmp;
+	float_4 z = x * x;
+	float_4 y = 7.0376836292e-2f;
+	y = y * x - 1.1514610310e-1f;
+	y = y * x + 1.1676998740e-1f;
+	y = y * x - 1.2420140846e-1f;
+	y = y * x + 1.4249322787e-1f;
+	y = y * x - 1.6668057665e-1f;
+	y = y * x + 2.0000714765e-1f;
+	y = y * x - 2.4999993993e-1f;
+	y = y * x + 3.3333331174e-1f;
+	y = y * x * z;
+	y = y + fe * -2.12194440e-4f;
+	y = y - z * 0.5f;
+	x = x + y + fe * 0.693359375f;
+	return x | invalid;
+}
+
+// Rack evaluates these with sse_mathfun too. Lane-wise libm is slower but exact, which is fine for a stand-in.
+#define ONDAS_HEADLESS_LANEWISE(name) \
+	inline float_4 name(float_4 a) { \
+		return float_4(std::name(a.s[0]), std::name(a.s[1]), std::name(a.s[2]), std::name(a.s[3])); \
+	}
+ONDAS_HEADLESS_LANEWISE(sin)
+ONDAS_HEADLESS_LANEWISE(cos)
+#undef ONDAS_HEADLESS_LANEWISE
+
+inline float_4 pow(float_4 a, float_4 b) {return exp(b * log(a));}
+inline float_4 pow(float a, float_4 b) {return exp(b * std::log(a));}
+inline float_4 pow(float_4 a, float b) {return exp(b * log(a));}
+
+} // namespace simd
+
+
+////////////////////
+// random
+////////////////////
+
+namespace random {
+
+struct Xoroshiro128Plus {
+	uint64_t state[2] = {};
+
+	void seed(uint64_t s0, uint64_t s1) {
+		state[0] = s0;
+		state[1] = s1;
+		// A bad seed will give a bad first result, so shift the state
+		operator()();
+	}
+	bool isSeeded() {return state[0] || state[1];}
+	static uint64_t rotl(uint64_t x, int k) {return (x << k) | (x >> (64 - k));}
+	uint64_t operator()() {
+		uint64_t s0 = state[0];
+		uint64_t s1 = state[1];
+		uint64_t result = s0 + s1;
+		s1 ^= s0;
+		state[0] = rotl(s0, 55) ^ s1 ^ (s1 << 14);
+		state[1] = rotl(s1, 36);
+		return result;
+	}
+	constexpr uint64_t min() const {return 0;}
+	constexpr uint64_t max() const {return UINT64_MAX;}
+};
+
+inline Xoroshiro128Plus& local() {
+	static thread_local Xoroshiro128Plus rng;
+	if (!rng.isSeeded())
+		rng.seed(0x9e3779b97f4a7c15ull, 0xbf58476d1ce4e5b9ull);
+	return rng;
+}
+
+template <typename T>
+T get() {return local()();}
+template <>
+inline uint32_t get() {return local()() >> 32;}
+template <>
+inline float get() {return (local()() >> (64 - 24)) * (1.f / 16777216.f);}
+
+inline uint32_t u32() {return get<uint32_t>();}
+inline uint64_t u64() {return get<uint64_t>();}
+inline float uniform() {return get<float>();}
+inline float normal() {
+	const float radius = std::sqrt(-2.f * std::log(1.f - get<float>()));
+	const float theta = 2.f * float(M_PI) * get<float>();
+	return radius * std::sin(theta);
+}
+
+} // namespace random
+
+
+////////////////////
+// dsp
+////////////////////
+
+namespace dsp {
+
+template <typename T = float>
+struct TSchmittTrigger {
+	T state;
+	TSchmittTrigger() {reset();}
+	void reset() {state = T::mask();}
+	T process(T in, T lowThreshold = 0.f, T highThreshold = 1.f) {
+		T on = (in >= highThreshold);
+		T off = (in <= lowThreshold);
+		T triggered = ~state & on;
+		state = on | (state & ~off);
+		return triggered;
+	}
+	T isHigh() {return state;}
+};
+
+template <>
+struct TSchmittTrigger<float> {
+	bool state = true;
+	TSchmittTrigger() {reset();}
+	void reset() {state = true;}
+	bool process(float in, float lowThreshold = 0.f, float highThreshold = 1.f) {
+		if (state) {
+			if (in <= lowThreshold)
+				state = false;
+		}
+		else {
+			if (in >= highThreshold) {
+				state = true;
+				return true;
+			}
+		}
+		return false;
+	}
+	bool isHigh() {return state;}
+};
+
+typedef TSchmittTrigger<> SchmittTrigger;
+
+struct BooleanTrigger {
+	bool state = true;
+	void reset() {state = true;}
+	bool process(bool state) {
+		bool triggered = (state && !this->state);
+		this->state = state;
+		return triggered;
+	}
+};
+
+struct PulseGenerator {
+	float remaining = 0.f;
+	void reset() {remaining = 0.f;}
+	bool process(float deltaTime) {
+		if (remaining > 0.f) {
+			remaining -= deltaTime;
+			return true;
+		}
+		return false;
+	}
+	void trigger(float duration = 1e-3f) {
+		if (duration > remaining)
+			remaining = duration;
+	}
+};
+
+struct Timer {
+	float time = 0.f;
+	void reset() {time = 0.f;}
+	float process(float deltaTime) {
+		time += deltaTime;
+		return time;
+	}
+};
+
+struct ClockDivider {
+	uint32_t clock = 0;
+	uint32_t division = 1;
+	void reset() {clock = 0;}
+	void setDivision(uint32_t division) {this->division = division;}
+	uint32_t getDivision() {return division;}
+	uint32_t getClock() {return clock;}
+	bool process() {
+		clock++;
+		if (clock >= division) {
+			clock = 0;
+			return true;
+		}
+		return false;
+	}
+};
+
+template <typename T = float>
+struct TRCFilter {
+	T c = 0.f;
+	T xstate[1];
+	T ystate[1];
+
+	TRCFilter() {reset();}
+	void reset() {
+		xstate[0] = 0.f;
+		ystate[0] = 0.f;
+	}
+	void setCutoff(T r) {c = 2.f / r;}
+	void setCutoffFreq(T f) {setCutoff(2.f * float(M_PI) * f);}
+	void process(T x) {
+		T y = (x + xstate[0] - ystate[0] * (1 - c)) / (1 + c);
+		xstate[0] = x;
+		ystate[0] = y;
+	}
+	T lowpass() {return ystate[0];}
+	T highpass() {return xstate[0] - ystate[0];}
+};
+
+typedef TRCFilter<> RCFilter;
+
+template <typename T = float>
+struct TExponentialFilter {
+	T out = 0.f;
+	T lambda = 0.f;
+	void reset() {out = 0.f;}
+	void setLambda(T lambda) {this->lambda = lambda;}
+	void setTau(T tau) {this->lambda = 1 / tau;}
+	T process(T deltaTime, T in) {
+		T y = out + (in - out) * lambda * deltaTime;
+		// If no change was made between the old and new output, assume T granularity is too small and snap output to input
+		out = (out == y) ? in : y;
+		return out;
+	}
+};
+
+typedef TExponentialFilter<> ExponentialFilter;
+
+template <typename T = float>
+struct TSlewLimiter {
+	T out = 0.f;
+	T rise = 0.f;
+	T fall = 0.f;
+	void reset() {out = 0.f;}
+	void setRiseFall(T rise, T fall) {
+		this->rise = rise;
+		this->fall = fall;
+	}
+	T process(T deltaTime, T in) {
+		out = clamp(in, out - fall * deltaTime, out + rise * deltaTime);
+		return out;
+	}
+};
+
+typedef TSlewLimiter<> SlewLimiter;
+
+/** Real FFT with the interface of Rack's, which wraps PFFFT, and its ordered layout: DC and Nyquist first, then the
+real and imaginary parts of bins 1 to length / 2 - 1. Unscaled both ways, like PFFFT. A plain radix-2 FFT of the
+full length here, as only the results need to match.
+*/
+struct RealFFT {
+	int length;
+	std::vector<float> cosTable;
+	std::vector<float> sinTable;
+	std::vector<float> re;
+	std::vector<float> im;
+
+	RealFFT(size_t length) : length(length), cosTable(length / 2), sinTable(length / 2), re(length), im(length) {
+		for (int k = 0; k < this->length / 2; k++) {
+			cosTable[k] = std::cos(2.0 * M_PI * k / length);
+			sinTable[k] = std::sin(2.0 * M_PI * k / length);
+		}
+	}
+
+	void rfft(const float* input, float* output) {
+		for (int i = 0; i < length; i++) {
+			re[i] = input[i];
+			im[i] = 0.f;
+		}
+		transform(-1.f);
+		output[0] = re[0];
+		output[1] = re[length / 2];
+		for (int k = 1; k < length / 2; k++) {
+			output[2 * k] = re[k];
+			output[2 * k + 1] = im[k];
+		}
+	}
+
+	void irfft(const float* input, float* output) {
+		re[0] = input[0];
+		im[0] = 0.f;
+		re[length / 2] = input[1];
+		im[length / 2] = 0.f;
+		for (int k = 1; k < length / 2; k++) {
+			re[k] = re[length - k] = input[2 * k];
+			im[k] = input[2 * k + 1];
+			im[length - k] = -input[2 * k + 1];
+		}
+		transform(1.f);
+		for (int i = 0; i < length; i++)
+			output[i] = re[i];
+	}
+
+	// PFFFT's own layout is faster; here it's the ordered one
+	void rfftUnordered(const float* input, float* output) {rfft(input, output);}
+	void irfftUnordered(const float* input, float* output) {irfft(input, output);}
+
+	void scale(float* x) {
+		float a = 1.f / length;
+		for (int i = 0; i < length; i++)
+			x[i] *= a;
+	}
+
+private:
+	/** In place on re and im, with exp(sign 2 pi i k n / length) */
+	void transform(float sign) {
+		for (int i = 1, j = 0; i < length; i++) {
+			int bit = length >> 1;
+			for (; j & bit; bit >>= 1)
+				j ^= bit;
+			j ^= bit;
+			if (i < j) {
+				std::swap(re[i], re[j]);
+				std::swap(im[i], im[j]);
+			}
+		}
+		for (int size = 2; size <= length; size *= 2) {
+			int stride = length / size;
+			for (int start = 0; start < length; start += size) {
+				for (int k = 0; k < size / 2; k++) {
+					float wr = cosTable[k * stride];
+					float wi = sign * sinTable[k * stride];
+					int a = start + k;
+					int b = a + size / 2;
+					float tr = re[b] * wr - im[b] * wi;
+					float ti = re[b] * wi + im[b] * wr;
+					re[b] = re[a] - tr;
+					im[b] = im[a] - ti;
+					re[a] += tr;
+					im[a] += ti;
+				}
+			}
+		}
+	}
+};
+
+} // namespace dsp
+
+
+////////////////////
+// window, asset, plugin
+////////////////////
+
+namespace window {
+
+struct Font {
+	int handle = -1;
+};
+
+struct Svg {
+	std::string path;
+};
+
+struct Window {
+	std::shared_ptr<Font> uiFont = std::make_shared<Font>();
+	std::map<std::string, std::shared_ptr<Font>> fontCache;
+	std::map<std::string, std::shared_ptr<Svg>> svgCache;
+
+	std::shared_ptr<Font> loadFont(const std::string& filename) {
+		std::shared_ptr<Font>& font = fontCache[filename];
+		if (!font)
+			font = std::make_shared<Font>();
+		return font;
+	}
+	std::shared_ptr<Svg> loadSvg(const std::string& filename) {
+		std::shared_ptr<Svg>& svg = svgCache[filename];
+		if (!svg) {
+			svg = std::make_shared<Svg>();
+			svg->path = filename;
+		}
+		return svg;
+	}
+};
+
+} // namespace window
+
+using window::Font;
+using window::Svg;
+
+namespace plugin {
+struct Plugin;
+struct Model;
+} // namespace plugin
+
+namespace asset {
+
+inline std::string& userDir() {
+	static std::string dir = ".";
+	return dir;
+}
+
+inline std::string system(std::string filename) {return rack::system::join("rack", filename);}
+inline std::string user(std::string filename) {return rack::system::join(userDir(), filename);}
+std::string plugin(plugin::Plugin* plugin, std::string filename);
+
+} // namespace asset
+
+
+////////////////////
+// engine
+////////////////////
+
+namespace engine {
+
+static const int PORT_MAX_CHANNELS = 16;
+
+struct Module;
+
+struct Param {
+	float value = 0.f;
+	float getValue() {return value;}
+	void setValue(float value) {this->value = value;}
+};
+
+struct Port {
+	float voltages[PORT_MAX_CHANNELS] = {};
+	uint8_t channels = 0;
+
+	enum Type {
+		INPUT,
+		OUTPUT,
+	};
+
+	void setVoltage(float voltage, int channel = 0) {voltages[channel] = voltage;}
+	float getVoltage(int channel = 0) {return voltages[channel];}
+	float getPolyVoltage(int channel) {return isMonophonic() ? getVoltage(0) : getVoltage(channel);}
+	float getNormalVoltage(float normalVoltage, int channel = 0) {return isConnected() ? getVoltage(channel) : normalVoltage;}
+	float getNormalPolyVoltage(float normalVoltage, int channel) {return isConnected() ? getPolyVoltage(channel) : normalVoltage;}
+	float* getVoltages(int firstChannel = 0) {return &voltages[firstChannel];}
+	void readVoltages(float* v) {
+		for (int c = 0; c < channels; c++)
+			v[c] = voltages[c];
+	}
+	void writeVoltages(const float* v) {
+		for (int c = 0; c < channels; c++)
+			voltages[c] = v[c];
+	}
+	void clearVoltages() {
+		for (int c = 0; c < channels; c++)
+			voltages[c] = 0.f;
+	}
+	float getVoltageSum() {
+		float sum = 0.f;
+		for (int c = 0; c < channels; c++)
+			sum += voltages[c];
+		return sum;
+	}
+
+	template <typename T>
+	T getVoltageSimd(int firstChannel) {return T::load(&voltages[firstChannel]);}
+	template <typename T>
+	T getPolyVoltageSimd(int firstChannel) {return isMonophonic() ? getVoltage(0) : getVoltageSimd<T>(firstChannel);}
+	template <typename T>
+	T getNormalVoltageSimd(T normalVoltage, int firstChannel) {return isConnected() ? getVoltageSimd<T>(firstChannel) : normalVoltage;}
+	template <typename T>
+	T getNormalPolyVoltageSimd(T normalVoltage, int firstChannel) {return isConnected() ? getPolyVoltageSimd<T>(firstChannel) : normalVoltage;}
+	template <typename T>
+	void setVoltageSimd(T voltage, int firstChannel) {voltage.store(&voltages[firstChannel]);}
+
+	void setChannels(int channels) {
+		// If disconnected, keep the number of channels at 0.
+		if (this->channels == 0)
+			return;
+		// Set higher channel voltages to 0
+		for (int c = channels; c < this->channels; c++)
+			voltages[c] = 0.f;
+		// Don't allow caller to set port as disconnected
+		if (channels == 0)
+			channels = 1;
+		this->channels = channels;
+	}
+	int getChannels() {return channels;}
+	bool isConnected() {return channels > 0;}
+	bool isMonophonic() {return channels == 1;}
+	bool isPolyphonic() {return channels > 1;}
+};
+
+struct Output : Port {};
+struct Input : Port {};
+
+struct Light {
+	float value = 0.f;
+	void setBrightness(float brightness) {value = brightness;}
+	float getBrightness() {return value;}
+	void setBrightnessSmooth(float brightness, float deltaTime, float lambda = 30.f) {
+		if (brightness < value) {
+			// Fade out light
+			value += (brightness - value) * lambda * deltaTime;
+		}
+		else {
+			// Turn on light instantly
+			value = brightness;
+		}
+	}
+	void setSmoothBrightness(float brightness, float deltaTime) {setBrightnessSmooth(brightness, deltaTime);}
+};
+
+struct ParamQuantity {
+	Module* module = NULL;
+	int paramId = -1;
+	float minValue = 0.f;
+	float maxValue = 1.f;
+	float defaultValue = 0.f;
+	std::string name;
+	std::string unit;
+	float displayBase = 0.f;
+	float displayMultiplier = 1.f;
+	float displayOffset = 0.f;
+	std::string description;
+	bool resetEnabled = true;
+	bool randomizeEnabled = true;
+	bool smoothEnabled = false;
+	bool snapEnabled = false;
+
+	virtual ~ParamQuantity() {}
+	Param* getParam();
+	virtual void setValue(float value);
+	virtual float getValue();
+	float getMinValue() {return minValue;}
+	float getMaxValue() {return maxValue;}
+	float getDefaultValue() {return defaultValue;}
+	float getScaledValue() {return math::rescale(getValue(), getMinValue(), getMaxValue(), 0.f, 1.f);}
+	void setScaledValue(float scaledValue) {setValue(math::rescale(scaledValue, 0.f, 1.f, getMinValue(), getMaxValue()));}
+	virtual std::string getLabel() {return name;}
+	virtual std::string getUnit() {return unit;}
+	virtual float getDisplayValue() {return getValue() * displayMultiplier + displayOffset;}
+	virtual void setDisplayValue(float displayValue) {setValue((displayValue - displayOffset) / displayMultiplier);}
+	virtual std::string getDisplayValueString() {return string::f("%g", getDisplayValue());}
+	virtual std::string getString() {return getLabel() + ": " + getDisplayValueString() + getUnit();}
+	virtual void reset() {setValue(getDefaultValue());}
+	virtual void randomize() {
+		if (!randomizeEnabled)
+			return;
+		float value = math::rescale(random::uniform(), 0.f, 1.f, getMinValue(), getMaxValue());
+		if (snapEnabled)
+			value = std::round(value);
+		setValue(value);
+	}
+};
+
+struct SwitchQuantity : ParamQuantity {
+	std::vector<std::string> labels;
+	std::string getDisplayValueString() override {
+		int index = (int) std::floor(getValue() - getMinValue());
+		if (index >= 0 && index < (int) labels.size())
+			return labels[index];
+		return ParamQuantity::getDisplayValueString();
+	}
+};
+
+struct PortInfo {
+	Module* module = NULL;
+	Port::Type type = Port::INPUT;
+	int portId = -1;
+	std::string name;
+	std::string description;
+	virtual ~PortInfo() {}
+	virtual std::string getName() {return name;}
+};
+
+struct LightInfo {
+	Module* module = NULL;
+	int lightId = -1;
+	std::string name;
+	std::string description;
+	virtual ~LightInfo() {}
+	virtual std::string getName() {return name;}
+};
+
+struct Module {
+	plugin::Model* model = NULL;
+	int64_t id = -1;
+
+	std::vector<Param> params;
+	std::vector<Input> inputs;
+	std::vector<Output> outputs;
+	std::vector<Light> lights;
+
+	std::vector<ParamQuantity*> paramQuantities;
+	std::vector<PortInfo*> inputInfos;
+	std::vector<PortInfo*> outputInfos;
+	std::vector<LightInfo*> lightInfos;
+
+	struct Expander {
+		int64_t moduleId = -1;
+		Module* module = NULL;
+		void* producerMessage = NULL;
+		void* consumerMessage = NULL;
+		bool messageFlipRequested = false;
+		void requestMessageFlip() {messageFlipRequested = true;}
+	};
+
+	Expander leftExpander;
+	Expander rightExpander;
+
+	Module() {}
+	virtual ~Module() {
+		for (ParamQuantity* q : paramQuantities)
+			delete q;
+		for (PortInfo* p : inputInfos)
+			delete p;
+		for (PortInfo* p : outputInfos)
+			delete p;
+		for (LightInfo* l : lightInfos)
+			delete l;
+	}
+
+	void config(int numParams, int numInputs, int numOutputs, int numLights = 0) {
+		params.resize(numParams);
+		inputs.resize(numInputs);
+		outputs.resize(numOutputs);
+		lights.resize(numLights);
+		paramQuantities.resize(numParams, NULL);
+		inputInfos.resize(numInputs, NULL);
+		outputInfos.resize(numOutputs, NULL);
+		lightInfos.resize(numLights, NULL);
+		for (int i = 0; i < numParams; i++)
+			configParam(i, 0.f, 1.f, 0.f);
+		for (int i = 0; i < numInputs; i++)
+			configInput(i);
+		for (int i = 0; i < numOutputs; i++)
+			configOutput(i);
+	}
+
+	template <class TParamQuantity = ParamQuantity>
+	TParamQuantity* configParam(int paramId, float minValue, float maxValue, float defaultValue, std::string name = "", std::string unit = "", float displayBase = 0.f, float displayMultiplier = 1.f, float displayOffset = 0.f) {
+		delete paramQuantities[paramId];
+		TParamQuantity* q = new TParamQuantity;
+		q->module = this;
+		q->paramId = paramId;
+		q->minValue = minValue;
+		q->maxValue = maxValue;
+		q->defaultValue = defaultValue;
+		q->name = name;
+		q->unit = unit;
+		q->displayBase = displayBase;
+		q->displayMultiplier = displayMultiplier;
+		q->displayOffset = displayOffset;
+		paramQuantities[paramId] = q;
+		params[paramId].value = q->getDefaultValue();
+		return q;
+	}
+
+	template <class TSwitchQuantity = SwitchQuantity>
+	TSwitchQuantity* configSwitch(int paramId, float minValue, float maxValue, float defaultValue, std::string name = "", std::vector<std::string> labels = {}) {
+		TSwitchQuantity* sq = configParam<TSwitchQuantity>(paramId, minValue, maxValue, defaultValue, name);
+		sq->snapEnabled = true;
+		sq->smoothEnabled = false;
+		sq->labels = labels;
+		return sq;
+	}
+
+	template <class TSwitchQuantity = SwitchQuantity>
+	TSwitchQuantity* configButton(int paramId, std::string name = "") {
+		TSwitchQuantity* sq = configParam<TSwitchQuantity>(paramId, 0.f, 1.f, 0.f, name);
+		sq->randomizeEnabled = false;
+		sq->snapEnabled = true;
+		return sq;
+	}
+
+	template <class TPortInfo = PortInfo>
+	TPortInfo* configInput(int portId, std::string name = "") {
+		delete inputInfos[portId];
+		TPortInfo* info = new TPortInfo;
+		info->module = this;
+		info->type = Port::INPUT;
+		info->portId = portId;
+		info->name = name;
+		inputInfos[portId] = info;
+		return info;
+	}
+
+	template <class TPortInfo = PortInfo>
+	TPortInfo* configOutput(int portId, std::string name = "") {
+		delete outputInfos[portId];
+		TPortInfo* info = new TPortInfo;
+		info->module = this;
+		info->type = Port::OUTPUT;
+		info->portId = portId;
+		info->name = name;
+		outputInfos[portId] = info;
+		return info;
+	}
+
+	template <class TLightInfo = LightInfo>
+	TLightInfo* configLight(int lightId, std::string name = "") {
+		delete lightInfos[lightId];
+		TLightInfo* info = new TLightInfo;
+		info->module = this;
+		info->lightId = lightId;
+		info->name = name;
+		lightInfos[lightId] = info;
+		return info;
+	}
+
+	void configBypass(int inputId, int outputId) {}
+
+	int getNumParams() {return params.size();}
+	Param& getParam(int index) {return params[index];}
+	ParamQuantity* getParamQuantity(int index) {return paramQuantities[index];}
+	int getNumInputs() {return inputs.size();}
+	Input& getInput(int index) {return inputs[index];}
+	int getNumOutputs() {return outputs.size();}
+	Output& getOutput(int index) {return outputs[index];}
+	int getNumLights() {return lights.size();}
+	Light& getLight(int index) {return lights[index];}
+	int64_t getId() {return id;}
+	plugin::Model* getModel() {return model;}
+	Expander& getLeftExpander() {return leftExpander;}
+	Expander& getRightExpander() {return rightExpander;}
+
+	struct ProcessArgs {
+		float sampleRate;
+		float sampleTime;
+		int64_t frame;
+	};
+
+	virtual void process(const ProcessArgs& args) {}
+	virtual json_t* dataToJson() {return NULL;}
+	virtual void dataFromJson(json_t* rootJ) {}
+
+	/** The module's part of a patch, like Rack's: param values by id, and "data" when dataToJson() gives any */
+	virtual json_t* toJson() {
+		json_t* rootJ = json_object();
+		json_t* paramsJ = json_array();
+		for (size_t i = 0; i < params.size(); i++) {
+			json_t* paramJ = json_object();
+			json_object_set_new(paramJ, "id", json_integer(i));
+			json_object_set_new(paramJ, "value", json_real(params[i].getValue()));
+			json_array_append_new(paramsJ, paramJ);
+		}
+		json_object_set_new(rootJ, "params", paramsJ);
+		json_t* dataJ = dataToJson();
+		if (dataJ)
+			json_object_set_new(rootJ, "data", dataJ);
+		return rootJ;
+	}
+
+	/** Loads what toJson() saved. As in Rack, dataFromJson() is only called when the patch has "data". */
+	virtual void fromJson(json_t* rootJ) {
+		size_t i;
+		json_t* paramJ;
+		json_array_foreach(json_object_get(rootJ, "params"), i, paramJ) {
+			json_t* idJ = json_object_get(paramJ, "id");
+			size_t id = idJ ? json_integer_value(idJ) : i;
+			json_t* valueJ = json_object_get(paramJ, "value");
+			if (id < params.size() && valueJ)
+				params[id].setValue(json_number_value(valueJ));
+		}
+		json_t* dataJ = json_object_get(rootJ, "data");
+		if (dataJ)
+			dataFromJson(dataJ);
+	}
+
+	struct AddEvent {};
+	struct RemoveEvent {};
+	struct PortChangeEvent {
+		bool connecting;
+		Port::Type type;
+		int portId;
+	};
+	struct SampleRateChangeEvent {
+		float sampleRate;
+		float sampleTime;
+	};
+	struct ExpanderChangeEvent {
+		uint8_t side;
+	};
+	struct ResetEvent {};
+	struct RandomizeEvent {};
+	struct SaveEvent {};
+
+	virtual void onAdd(const AddEvent& e) {onAdd();}
+	virtual void onRemove(const RemoveEvent& e) {onRemove();}
+	virtual void onPortChange(const PortChangeEvent& e) {}
+	virtual void onSampleRateChange(const SampleRateChangeEvent& e) {onSampleRateChange();}
+	virtual void onExpanderChange(const ExpanderChangeEvent& e) {}
+	virtual void onReset(const ResetEvent& e) {
+		for (ParamQuantity* q : paramQuantities) {
+			if (q && q->resetEnabled)
+				q->reset();
+		}
+		onReset();
+	}
+	virtual void onRandomize(const RandomizeEvent& e) {
+		for (ParamQuantity* q : paramQuantities) {
+			if (q)
+				q->randomize();
+		}
+		onRandomize();
+	}
+	virtual void onSave(const SaveEvent& e) {}
+
+	virtual void onAdd() {}
+	virtual void onRemove() {}
+	virtual void onReset() {}
+	virtual void onRandomize() {}
+	virtual void onSampleRateChange() {}
+};
+
+inline Param* ParamQuantity::getParam() {
+	if (!module || paramId < 0 || paramId >= (int) module->params.size())
+		return NULL;
+	return &module->params[paramId];
+}
+
+inline void ParamQuantity::setValue(float value) {
+	Param* param = getParam();
+	if (param)
+		param->setValue(math::clamp(value, getMinValue(), getMaxValue()));
+}
+
+inline float ParamQuantity::getValue() {
+	Param* param = getParam();
+	return param ? param->getValue() : 0.f;
+}
+
+struct Engine {
+	float sampleRate = 44100.f;
+	float getSampleRate() {return sampleRate;}
+	float getSampleTime() {return 1.f / sampleRate;}
+};
+
+} // namespace engine
+
+
+////////////////////
+// widgets (compile-only)
+////////////////////
+
+namespace widget {
+
+struct Widget {
+	math::Rect box;
+	Widget* parent = NULL;
+	std::list<Widget*> children;
+	bool visible = true;
+	bool requestedDelete = false;
+
+	virtual ~Widget() {clearChildren();}
+
+	math::Rect getBox() {return box;}
+	void setPosition(math::Vec pos) {box.pos = pos;}
+	void setSize(math::Vec size) {box.size = size;}
+	void show() {visible = true;}
+	void hide() {visible = false;}
+	bool isVisible() {return visible;}
+
+	template <class T>
+	T* getAncestorOfType() {
+		for (Widget* p = parent; p; p = p->parent) {
+			T* t = dynamic_cast<T*>(p);
+			if (t)
+				return t;
+		}
+		return NULL;
+	}
+	void addChild(Widget* child) {
+		child->parent = this;
+		children.push_back(child);
+	}
+	void addChildBottom(Widget* child) {
+		child->parent = this;
+		children.push_front(child);
+	}
+	void removeChild(Widget* child) {
+		children.remove(child);
+		child->parent = NULL;
+	}
+	void clearChildren() {
+		for (Widget* child : children)
+			delete child;
+		children.clear();
+	}
+
+	struct DrawArgs {
+		NVGcontext* vg = NULL;
+		math::Rect clipBox;
+		NVGLUframebuffer* fb = NULL;
+	};
+
+	struct BaseEvent {
+		mutable Widget* target = NULL;
+		void consume(Widget* w) const {target = w;}
+		bool isConsumed() const {return target != NULL;}
+	};
+	struct PositionBaseEvent {
+		math::Vec pos;
+	};
+	struct HoverEvent : BaseEvent, PositionBaseEvent {
+		math::Vec mouseDelta;
+	};
+	struct ButtonEvent : BaseEvent, PositionBaseEvent {
+		int button = 0;
+		int action = 0;
+		int mods = 0;
+	};
+	struct DoubleClickEvent : BaseEvent {};
+	struct EnterEvent : BaseEvent {};
+	struct LeaveEvent : BaseEvent {};
+	struct DragBaseEvent : BaseEvent {
+		int button = 0;
+	};
+	struct DragStartEvent : DragBaseEvent {};
+	struct DragEndEvent : DragBaseEvent {};
+	struct DragMoveEvent : DragBaseEvent {
+		math::Vec mouseDelta;
+	};
+	struct DragHoverEvent : DragBaseEvent, PositionBaseEvent {
+		Widget* origin = NULL;
+		math::Vec mouseDelta;
+	};
+	struct ActionEvent : BaseEvent {};
+	struct ChangeEvent : BaseEvent {};
+	struct DirtyEvent : BaseEvent {};
+
+	virtual void step() {
+		for (Widget* child : children)
+			child->step();
+	}
+	virtual void draw(const DrawArgs& args) {
+		for (Widget* child : children) {
+			if (child->visible)
+				child->draw(args);
+		}
+	}
+	virtual void drawLayer(const DrawArgs& args, int layer) {}
+
+	virtual void onHover(const HoverEvent& e) {}
+	virtual void onButton(const ButtonEvent& e) {}
+	virtual void onDoubleClick(const DoubleClickEvent& e) {}
+	virtual void onEnter(const EnterEvent& e) {}
+	virtual void onLeave(const LeaveEvent& e) {}
+	virtual void onDragStart(const DragStartEvent& e) {}
+	virtual void onDragEnd(const DragEndEvent& e) {}
+	virtual void onDragMove(const DragMoveEvent& e) {}
+	virtual void onDragHover(const DragHoverEvent& e) {}
+	virtual void onAction(const ActionEvent& e) {}
+	virtual void onChange(const ChangeEvent& e) {}
+	virtual void onDirty(const DirtyEvent& e) {}
+};
+
+struct TransparentWidget : Widget {};
+struct OpaqueWidget : Widget {};
+
+struct FramebufferWidget : Widget {
+	bool dirty = true;
+	bool bypassed = false;
+	float oversample = 1.f;
+	void setDirty(bool dirty = true) {this->dirty = dirty;}
+	void onDirty(const DirtyEvent& e) override {setDirty();}
+};
+
+struct SvgWidget : Widget {
+	std::shared_ptr<window::Svg> svg;
+	void setSvg(std::shared_ptr<window::Svg> svg) {this->svg = svg;}
+};
+
+} // namespace widget
+
+
+namespace ui {
+
+struct Menu : widget::OpaqueWidget {};
+
+struct MenuEntry : widget::OpaqueWidget {};
+
+struct MenuLabel : MenuEntry {
+	std::string text;
+};
+
+struct MenuSeparator : MenuEntry {};
+
+struct MenuItem : MenuEntry {
+	std::string text;
+	std::string rightText;
+	bool disabled = false;
+	virtual Menu* createChildMenu() {return NULL;}
+};
+
+} // namespace ui
+
+
+namespace app {
+
+struct ParamWidget : widget::OpaqueWidget {
+	engine::Module* module = NULL;
+	int paramId = -1;
+	engine::ParamQuantity* getParamQuantity() {return module ? module->paramQuantities[paramId] : NULL;}
+};
+
+struct PortWidget : widget::OpaqueWidget {
+	engine::Module* module = NULL;
+	engine::Port::Type type = engine::Port::INPUT;
+	int portId = -1;
+};
+
+struct SvgPort : PortWidget {
+	void setSvg(std::shared_ptr<window::Svg> svg) {}
+};
+
+struct Knob : ParamWidget {
+	bool snap = false;
+	float minAngle = -0.83f * float(M_PI);
+	float maxAngle = 0.83f * float(M_PI);
+};
+
+struct SvgKnob : Knob {
+	void setSvg(std::shared_ptr<window::Svg> svg) {}
+};
+
+struct Switch : ParamWidget {
+	bool momentary = false;
+};
+
+struct SvgSwitch : Switch {
+	std::vector<std::shared_ptr<window::Svg>> frames;
+	void addFrame(std::shared_ptr<window::Svg> svg) {frames.push_back(svg);}
+};
+
+DEPRECATED typedef SvgSwitch SVGSwitch;
+
+struct LightWidget : widget::TransparentWidget {
+	NVGcolor bgColor = nvgRGBA(0, 0, 0, 0);
+	NVGcolor color = nvgRGBA(0, 0, 0, 0);
+	NVGcolor borderColor = nvgRGBA(0, 0, 0, 0);
+};
+
+struct MultiLightWidget : LightWidget {
+	std::vector<NVGcolor> baseColors;
+	void addBaseColor(NVGcolor baseColor) {baseColors.push_back(baseColor);}
+};
+
+struct ModuleLightWidget : MultiLightWidget {
+	engine::Module* module = NULL;
+	int firstLightId = -1;
+};
+
+struct SvgPanel : widget::Widget {
+	void setBackground(std::shared_ptr<window::Svg> svg) {
+		// Rack panels are 128.5mm high; the width comes from the SVG, which isn't parsed here.
+		box.size = math::Vec(0.f, 380.f);
+	}
+};
+
+struct SvgScrew : widget::Widget {};
+
+struct ModuleWidget : widget::OpaqueWidget {
+	plugin::Model* model = NULL;
+	engine::Module* module = NULL;
+	widget::Widget* panel = NULL;
+
+	void setModel(plugin::Model* model) {this->model = model;}
+	void setModule(engine::Module* module) {this->module = module;}
+	engine::Module* getModule() {return module;}
+	template <class TModule>
+	TModule* getModule() {return dynamic_cast<TModule*>(module);}
+	void setPanel(widget::Widget* panel) {
+		this->panel = panel;
+		addChildBottom(panel);
+		box.size = panel->box.size;
+	}
+	void addParam(ParamWidget* param) {addChild(param);}
+	void addInput(PortWidget* input) {addChild(input);}
+	void addOutput(PortWidget* output) {addChild(output);}
+	virtual void appendContextMenu(ui::Menu* menu) {}
+};
+
+} // namespace app
+
+
+namespace componentlibrary {
+
+static const NVGcolor SCHEME_BLACK_TRANSPARENT = nvgRGBA(0x00, 0x00, 0x00, 0x00);
+static const NVGcolor SCHEME_BLACK = nvgRGB(0x00, 0x00, 0x00);
+static const NVGcolor SCHEME_WHITE = nvgRGB(0xff, 0xff, 0xff);
+static const NVGcolor SCHEME_RED = nvgRGB(0xed, 0x2c, 0x24);
+static const NVGcolor SCHEME_BLUE = nvgRGB(0x29, 0xb2, 0xef);
+static const NVGcolor SCHEME_GREEN = nvgRGB(0x90, 0xc7, 0x3e);
+static const NVGcolor SCHEME_YELLOW = nvgRGB(0xff, 0xd7, 0x14);
+
+template <typename TBase = app::ModuleLightWidget>
+struct TGrayModuleLightWidget : TBase {};
+typedef TGrayModuleLightWidget<> GrayModuleLightWidget;
+
+template <typename TBase = GrayModuleLightWidget>
+struct TRedLight : TBase {
+	TRedLight() {this->addBaseColor(SCHEME_RED);}
+};
+typedef TRedLight<> RedLight;
+
+template <typename TBase = GrayModuleLightWidget>
+struct TBlueLight : TBase {
+	TBlueLight() {this->addBaseColor(SCHEME_BLUE);}
+};
+typedef TBlueLight<> BlueLight;
+
+template <typename TBase = GrayModuleLightWidget>
+struct TGreenLight : TBase {
+	TGreenLight() {this->addBaseColor(SCHEME_GREEN);}
+};
+typedef TGreenLight<> GreenLight;
+
+template <typename TBase = GrayModuleLightWidget>
+struct TYellowLight : TBase {
+	TYellowLight() {this->addBaseColor(SCHEME_YELLOW);}
+};
+typedef TYellowLight<> YellowLight;
+
+template <typename TBase>
+struct TinyLight : TBase {};
+template <typename TBase>
+struct SmallLight : TBase {};
+template <typename TBase>
+struct MediumLight : TBase {};
+template <typename TBase>
+struct LargeLight : TBase {};
+
+struct RoundKnob : app::SvgKnob {};
+struct RoundBlackKnob : RoundKnob {};
+struct RoundSmallBlackKnob : RoundKnob {};
+struct RoundLargeBlackKnob : RoundKnob {};
+struct Trimpot : app::SvgKnob {};
+struct CKSS : app::SvgSwitch {};
+struct CKSSThree : app::SvgSwitch {};
+struct VCVButton : app::SvgSwitch {
+	VCVButton() {momentary = true;}
+};
+struct PJ301MPort : app::SvgPort {};
+struct DarkPJ301MPort : app::SvgPort {};
+struct ScrewSilver : app::SvgScrew {};
+struct ScrewBlack : app::SvgScrew {};
+
+} // namespace componentlibrary
+
+
+////////////////////
+// plugin, context
+////////////////////
+
+namespace plugin {
+
+struct Model {
+	Plugin* plugin = NULL;
+	std::string slug;
+	std::string name;
+	virtual ~Model() {}
+	virtual engine::Module* createModule() {return NULL;}
+	virtual app::ModuleWidget* createModuleWidget(engine::Module* m) {return NULL;}
+};
+
+struct Plugin {
+	std::string path = ".";
+	std::string slug;
+	std::vector<Model*> models;
+	~Plugin() {
+		for (Model* model : models)
+			delete model;
+	}
+	void addModel(Model* model) {
+		model->plugin = this;
+		models.push_back(model);
+	}
+	Model* getModel(const std::string& slug) {
+		for (Model* model : models) {
+			if (model->slug == slug)
+				return model;
+		}
+		return NULL;
+	}
+};
+
+} // namespace plugin
+
+inline std::string asset::plugin(plugin::Plugin* plugin, std::string filename) {
+	return rack::system::join(plugin ? plugin->path : ".", filename);
+}
+
+namespace history {
+
+struct Action {
+	std::string name;
+	virtual ~Action() {}
+};
+
+struct ModuleAction : Action {
+	int64_t moduleId = -1;
+};
+
+struct ParamChange : ModuleAction {
+	int paramId = -1;
+	float oldValue = 0.f;
+	float newValue = 0.f;
+};
+
+struct ComplexAction : Action {
+	std::vector<Action*> actions;
+	~ComplexAction() {
+		for (Action* action : actions)
+			delete action;
+	}
+	void push(Action* action) {actions.push_back(action);}
+	bool isEmpty() {return actions.empty();}
+};
+
+/** Takes ownership of pushed actions. There's nothing to undo headless, so they're dropped. */
+struct State {
+	void push(Action* action) {delete action;}
+};
+
+} // namespace history
+
+struct Context {
+	engine::Engine* engine = NULL;
+	window::Window* window = NULL;
+	history::State* history = NULL;
+};
+
+inline Context* contextGet() {
+	static engine::Engine engine;
+	static window::Window window;
+	static history::State history;
+	static Context context;
+	context.engine = &engine;
+	context.window = &window;
+	context.history = &history;
+	return &context;
+}
+
+#define APP rack::contextGet()
+
+
+////////////////////
+// helpers
+////////////////////
+
+static const float RACK_GRID_WIDTH = 15;
+static const float RACK_GRID_HEIGHT = 380;
+
+inline math::Vec mm2px(math::Vec mm) {return mm.mult(75.f / 25.4f);}
+
+template <class TModule, class TModuleWidget>
+plugin::Model* createModel(std::string slug) {
+	struct TModel : plugin::Model {
+		engine::Module* createModule() override {
+			engine::Module* m = new TModule;
+			m->model = this;
+			return m;
+		}
+		app::ModuleWidget* createModuleWidget(engine::Module* m) override {
+			TModule* tm = NULL;
+			if (m)
+				tm = dynamic_cast<TModule*>(m);
+			app::ModuleWidget* mw = new TModuleWidget(tm);
+			mw->setModel(this);
+			return mw;
+		}
+	};
+	plugin::Model* o = new TModel;
+	o->slug = slug;
+	return o;
+}
+
+template <class TWidget>
+TWidget* createWidget(math::Vec pos) {
+	TWidget* o = new TWidget;
+	o->box.pos = pos;
+	return o;
+}
+
+template <class TWidget>
+TWidget* createWidgetCentered(math::Vec pos) {
+	TWidget* o = createWidget<TWidget>(pos);
+	o->box.pos = o->box.pos.minus(o->box.size.div(2));
+	return o;
+}
+
+template <class TPanel = app::SvgPanel>
+TPanel* createPanel(std::string svgPath) {
+	TPanel* panel = new TPanel;
+	panel->setBackground(APP->window->loadSvg(svgPath));
+	return panel;
+}
+
+template <class TParamWidget>
+TParamWidget* createParam(math::Vec pos, engine::Module* module, int paramId) {
+	TParamWidget* o = createWidget<TParamWidget>(pos);
+	o->module = module;
+	o->paramId = paramId;
+	return o;
+}
+
+template <class TParamWidget>
+TParamWidget* createParamCentered(math::Vec pos, engine::Module* module, int paramId) {
+	TParamWidget* o = createParam<TParamWidget>(pos, module, paramId);
+	o->box.pos = o->box.pos.minus(o->box.size.div(2));
+	return o;
+}
+
+template <class TPortWidget>
+TPortWidget* createInput(math::Vec pos, engine::Module* module, int inputId) {
+	TPortWidget* o = createWidget<TPortWidget>(pos);
+	o->module = module;
+	o->type = engine::Port::INPUT;
+	o->portId = inputId;
+	return o;
+}
+
+template <class TPortWidget>
+TPortWidget* createInputCentered(math::Vec pos, engine::Module* module, int inputId) {
+	TPortWidget* o = createInput<TPortWidget>(pos, module, inputId);
+	o->box.pos = o->box.pos.minus(o->box.size.div(2));
+	return o;
+}
+
+template <class TPortWidget>
+TPortWidget* createOutput(math::Vec pos, engine::Module* module, int outputId) {
+	TPortWidget* o = createWidget<TPortWidget>(pos);
+	o->module = module;
+	o->type = engine::Port::OUTPUT;
+	o->portId = outputId;
+	return o;
+}
+
+template <class TPortWidget>
+TPortWidget* createOutputCentered(math::Vec pos, engine::Module* module, int outputId) {
+	TPortWidget* o = createOutput<TPortWidget>(pos, module, outputId);
+	o->box.pos = o->box.pos.minus(o->box.size.div(2));
+	return o;
+}
+
+template <class TModuleLightWidget>
+TModuleLightWidget* createLight(math::Vec pos, engine::Module* module, int firstLightId) {
+	TModuleLightWidget* o = createWidget<TModuleLightWidget>(pos);
+	o->module = module;
+	o->firstLightId = firstLightId;
+	return o;
+}
+
+template <class TModuleLightWidget>
+TModuleLightWidget* createLightCentered(math::Vec pos, engine::Module* module, int firstLightId) {
+	TModuleLightWidget* o = createLight<TModuleLightWidget>(pos, module, firstLightId);
+	o->box.pos = o->box.pos.minus(o->box.size.div(2));
+	return o;
+}
+
+template <class TMenuLabel = ui::MenuLabel>
+TMenuLabel* createMenuLabel(std::string text) {
+	TMenuLabel* o = new TMenuLabel;
+	o->text = text;
+	return o;
+}
+
+template <class TMenuItem = ui::MenuItem>
+TMenuItem* createMenuItem(std::string text, std::string rightText = "") {
+	TMenuItem* o = new TMenuItem;
+	o->text = text;
+	o->rightText = rightText;
+	return o;
+}
+
+template <class TMenuItem = ui::MenuItem>
+TMenuItem* createMenuItem(std::string text, std::string rightText, std::function<void()> action, bool disabled = false, bool alwaysConsume = false) {
+	TMenuItem* item = createMenuItem<TMenuItem>(text, rightText);
+	item->disabled = disabled;
+	return item;
+}
+
+template <class TMenuItem = ui::MenuItem>
+ui::MenuItem* createCheckMenuItem(std::string text, std::string rightText, std::function<bool()> checked, std::function<void()> action, bool disabled = false, bool alwaysConsume = false) {
+	return createMenuItem<TMenuItem>(text, rightText, action, disabled, alwaysConsume);
+}
+
+template <class TMenuItem = ui::MenuItem>
+ui::MenuItem* createBoolMenuItem(std::string text, std::string rightText, std::function<bool()> getter, std::function<void(bool state)> setter, bool disabled = false, bool alwaysConsume = false) {
+	return createMenuItem<TMenuItem>(text, rightText, [=]() {setter(!getter());}, disabled, alwaysConsume);
+}
+
+template <typename T>
+ui::MenuItem* createBoolPtrMenuItem(std::string text, std::string rightText, T* ptr) {
+	return createBoolMenuItem(text, rightText, [=]() {return ptr ? *ptr : false;}, [=](T val) {if (ptr) *ptr = val;});
+}
+
+template <class TMenuItem = ui::MenuItem>
+ui::MenuItem* createSubmenuItem(std::string text, std::string rightText, std::function<void(ui::Menu* menu)> createMenu, bool disabled = false) {
+	return createMenuItem<TMenuItem>(text, rightText + (rightText.empty() ? "" : "  ") + RIGHT_ARROW, NULL, disabled);
+}
+
+template <class TMenuItem = ui::MenuItem>
+ui::MenuItem* createIndexSubmenuItem(std::string text, std::vector<std::string> labels, std::function<size_t()> getter, std::function<void(size_t val)> setter, bool disabled = false, bool alwaysConsume = false) {
+	return createMenuItem<TMenuItem>(text, RIGHT_ARROW, NULL, disabled, alwaysConsume);
+}
+
+template <typename T>
+ui::MenuItem* createIndexPtrSubmenuItem(std::string text, std::vector<std::string> labels, T* ptr) {
+	return createIndexSubmenuItem(text, labels, [=]() {return ptr ? *ptr : 0;}, [=](size_t index) {if (ptr) *ptr = T(index);});
+}
+
+
+// Import some namespaces for convenience, like rack.hpp does
+using namespace logger;
+using namespace math;
+using namespace widget;
+using namespace ui;
+using namespace app;
+using plugin::Plugin;
+using plugin::Model;
+using namespace engine;
+using namespace componentlibrary;
+
+} // namespace rack
+
+
+extern "C" {
+void init(rack::plugin::Plugin* plugin);
+}
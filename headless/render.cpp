@@ -0,0 +1,292 @@
+// Offline renderer: plays patches of Ondas modules faster than realtime and writes what they output to WAV files.
+//
+// A patch is described in a JSON file as a list of chains. Each chain is a row of modules placed side by side, so
+// Klok, Secu and BaBum share the transport the way they do in the rack, with cables between their ports and
+// generated signals (clocks, LFOs, noise) into inputs. Chains don't talk to each other, so they can render on
+// separate threads. Every chain writes the outputs it records to one file, a channel per output channel.
+//
+// Usage: render [-j threads] [-t seconds] [-r sample rate] [-o dir] description.json
+// -t and -r override "seconds" and "sampleRate" from the description. -j 0 uses a thread per CPU core. Files are
+// written to the directory given with -o, or the current one.
+// See headless/examples/ for descriptions, and the README for the format.
+#include "harness.hpp"
+#include "wav.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <thread>
+
+using namespace headless;
+
+
+struct Chain {
+	std::string name;
+	std::string path;
+	Row* row = NULL;
+	std::map<std::string, Instance*> modules;
+	// Outputs to record, added to the capture after the first frame when their channel counts are known
+	std::vector<std::pair<Instance*, int>> recorded;
+
+	int channels = 0;
+	double wallSeconds = 0.0;
+	std::string error;
+
+	Chain() {}
+	Chain(const Chain&) = delete;
+	~Chain() {
+		delete row;
+	}
+
+	/** Splits a "module:port pattern" reference, throwing if the module isn't in the chain */
+	Instance& findPort(const std::string& reference, std::string& pattern) {
+		size_t colon = reference.find(':');
+		if (colon == std::string::npos)
+			throw std::runtime_error(name + ": \"" + reference + "\" should be \"module:port\"");
+		std::string moduleName = reference.substr(0, colon);
+		auto it = modules.find(moduleName);
+		if (it == modules.end())
+			throw std::runtime_error(name + ": no module named \"" + moduleName + "\"");
+		pattern = reference.substr(colon + 1);
+		return *it->second;
+	}
+};
+
+
+static std::string getString(json_t* objectJ, const char* key, const std::string& fallback = "") {
+	const char* s = json_string_value(json_object_get(objectJ, key));
+	return s ? s : fallback;
+}
+
+static float getNumber(json_t* objectJ, const char* key, float fallback) {
+	json_t* valueJ = json_object_get(objectJ, key);
+	return json_is_number(valueJ) ? json_number_value(valueJ) : fallback;
+}
+
+
+static Signal parseSignal(json_t* signalJ, const std::string& type) {
+	float amp = getNumber(signalJ, "amp", 5.f);
+	if (type == "dc")
+		return Signal::dc(getNumber(signalJ, "voltage", 0.f));
+	if (type == "clock")
+		return Signal::clock(getNumber(signalJ, "bpm", 120.f), getNumber(signalJ, "width", 1e-3f), getNumber(signalJ, "offset", 0.f));
+	if (type == "sine")
+		return Signal::sine(getNumber(signalJ, "freq", 1.f), amp);
+	if (type == "saw")
+		return Signal::saw(getNumber(signalJ, "freq", 1.f), amp);
+	if (type == "noise")
+		return Signal::noise(amp);
+	throw std::runtime_error("unknown signal type \"" + type + "\", expected dc, clock, sine, saw or noise");
+}
+
+
+/** Builds the modules, signals and cables of a chain. Runs on the main thread, as creating modules sets the engine
+sample rate, which is global.
+*/
+static void buildChain(Chain& chain, json_t* chainJ, float sampleRate) {
+	chain.row = new Row(sampleRate);
+
+	size_t i;
+	json_t* moduleJ;
+	json_array_foreach(json_object_get(chainJ, "modules"), i, moduleJ) {
+		std::string model = getString(moduleJ, "model");
+		std::string name = getString(moduleJ, "name", model);
+		if (chain.modules.count(name))
+			throw std::runtime_error(chain.name + ": two modules named \"" + name + "\", give them a \"name\"");
+		Instance& instance = chain.row->add(model);
+		chain.modules[name] = &instance;
+
+		// Data first, as loading some of it (Secu's patterns) rewrites params
+		const char* key;
+		json_t* valueJ;
+		json_object_foreach(json_object_get(moduleJ, "data"), key, valueJ) {
+			instance.setData(key, json_incref(valueJ));
+		}
+		json_object_foreach(json_object_get(moduleJ, "params"), key, valueJ) {
+			instance.setParam(key, json_number_value(valueJ));
+		}
+	}
+	if (chain.modules.empty())
+		throw std::runtime_error(chain.name + ": no modules");
+
+	json_t* signalJ;
+	json_array_foreach(json_object_get(chainJ, "signals"), i, signalJ) {
+		std::string pattern;
+		Instance& instance = chain.findPort(getString(signalJ, "to"), pattern);
+		int channels = clamp((int) getNumber(signalJ, "channels", 1.f), 1, PORT_MAX_CHANNELS);
+		instance.connectInput(pattern, parseSignal(signalJ, getString(signalJ, "type")), channels);
+	}
+
+	json_t* cableJ;
+	json_array_foreach(json_object_get(chainJ, "cables"), i, cableJ) {
+		std::string fromPattern, toPattern;
+		Instance& from = chain.findPort(getString(cableJ, "from"), fromPattern);
+		Instance& to = chain.findPort(getString(cableJ, "to"), toPattern);
+		std::vector<int> outputIds = from.findOutputs(fromPattern);
+		if (outputIds.size() != 1)
+			throw std::runtime_error(chain.name + ": cables start at one output, \"" + fromPattern + "\" matches several");
+		// A pattern matching several inputs fans the output out to all of them
+		for (int inputId : to.findInputs(toPattern))
+			chain.row->connect(from, outputIds[0], to, inputId);
+	}
+
+	json_t* recordJ;
+	json_array_foreach(json_object_get(chainJ, "record"), i, recordJ) {
+		const char* reference = json_string_value(recordJ);
+		std::string pattern;
+		Instance& instance = chain.findPort(reference ? reference : "", pattern);
+		for (int outputId : instance.findOutputs(pattern)) {
+			instance.connectOutput(outputId);
+			chain.recorded.push_back(std::make_pair(&instance, outputId));
+		}
+	}
+	if (chain.recorded.empty())
+		throw std::runtime_error(chain.name + ": nothing to record");
+}
+
+
+static void renderChain(Chain& chain, int64_t frames) {
+	auto start = std::chrono::steady_clock::now();
+
+	Row& row = *chain.row;
+	Capture capture;
+	WavWriter writer;
+	std::vector<float> block;
+	const int blockFrames = 4096;
+	// Channel counts take a frame per cable to travel down the chain, so settle them before recording
+	if (!row.cables.empty())
+		row.step(row.cables.size());
+	for (int64_t done = 0; done < frames; done += blockFrames) {
+		int n = std::min<int64_t>(blockFrames, frames - done);
+		row.fill(n);
+		block.clear();
+		for (int i = 0; i < n; i++) {
+			row.processFrame(i);
+			if (done + i == 0) {
+				for (auto& output : chain.recorded)
+					capture.add(*output.first, output.second);
+				chain.channels = capture.channels.size();
+				if (!writer.open(chain.path, chain.channels, row.sampleRate))
+					throw std::runtime_error("could not open " + chain.path);
+			}
+			capture.append(block);
+		}
+		writer.write(block.data(), n);
+	}
+	if (!writer.close())
+		throw std::runtime_error("could not write " + chain.path);
+
+	chain.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+int main(int argc, char** argv) {
+	int threads = 1;
+	float seconds = 0.f;
+	float sampleRate = 0.f;
+	std::string dir;
+	std::string descriptionPath;
+
+	for (int i = 1; i < argc; i++) {
+		if (!std::strcmp(argv[i], "-j") && i + 1 < argc) {
+			threads = std::atoi(argv[++i]);
+		}
+		else if (!std::strcmp(argv[i], "-t") && i + 1 < argc) {
+			seconds = std::atof(argv[++i]);
+		}
+		else if (!std::strcmp(argv[i], "-r") && i + 1 < argc) {
+			sampleRate = std::atof(argv[++i]);
+		}
+		else if (!std::strcmp(argv[i], "-o") && i + 1 < argc) {
+			dir = argv[++i];
+		}
+		else if (!std::strcmp(argv[i], "-h") || !std::strcmp(argv[i], "--help")) {
+			std::printf("Usage: %s [-j threads] [-t seconds] [-r sample rate] [-o dir] description.json\n", argv[0]);
+			return 0;
+		}
+		else {
+			descriptionPath = argv[i];
+		}
+	}
+	if (descriptionPath.empty()) {
+		std::fprintf(stderr, "Usage: %s [-j threads] [-t seconds] [-r sample rate] [-o dir] description.json\n", argv[0]);
+		return 2;
+	}
+	if (!dir.empty() && !system::createDirectories(dir)) {
+		std::fprintf(stderr, "Could not create %s\n", dir.c_str());
+		return 1;
+	}
+
+	json_error_t error;
+	json_t* rootJ = json_load_file(descriptionPath.c_str(), 0, &error);
+	if (!rootJ) {
+		std::fprintf(stderr, "%s:%d:%d: %s\n", descriptionPath.c_str(), error.line, error.column, error.text);
+		return 1;
+	}
+	if (seconds <= 0.f)
+		seconds = getNumber(rootJ, "seconds", 60.f);
+	if (sampleRate <= 0.f)
+		sampleRate = getNumber(rootJ, "sampleRate", 48000.f);
+	if (threads <= 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	std::vector<Chain> chains(json_array_size(json_object_get(rootJ, "chains")));
+	try {
+		size_t i;
+		json_t* chainJ;
+		json_array_foreach(json_object_get(rootJ, "chains"), i, chainJ) {
+			Chain& chain = chains[i];
+			chain.name = getString(chainJ, "name", string::f("chain%d", (int) i + 1));
+			chain.path = getString(chainJ, "file", chain.name + ".wav");
+			if (!dir.empty())
+				chain.path = system::join(dir, chain.path);
+			buildChain(chain, chainJ, sampleRate);
+		}
+	}
+	catch (std::exception& e) {
+		std::fprintf(stderr, "%s: %s\n", descriptionPath.c_str(), e.what());
+		json_decref(rootJ);
+		return 1;
+	}
+	json_decref(rootJ);
+	if (chains.empty()) {
+		std::fprintf(stderr, "%s: no chains\n", descriptionPath.c_str());
+		return 1;
+	}
+
+	// Threads take the next chain until there are none left
+	int64_t frames = int64_t(seconds * sampleRate);
+	std::atomic<size_t> next(0);
+	auto work = [&]() {
+		for (size_t i; (i = next++) < chains.size();) {
+			try {
+				renderChain(chains[i], frames);
+			}
+			catch (std::exception& e) {
+				chains[i].error = e.what();
+			}
+		}
+	};
+	threads = std::min<int>(threads, chains.size());
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for (int t = 1; t < threads; t++)
+		workers.push_back(std::thread(work));
+	work();
+	for (std::thread& worker : workers)
+		worker.join();
+	double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	int failures = 0;
+	for (const Chain& chain : chains) {
+		if (!chain.error.empty()) {
+			std::fprintf(stderr, "%s: %s\n", chain.name.c_str(), chain.error.c_str());
+			failures++;
+			continue;
+		}
+		std::printf("%-16s %3d channels  %8.2f s  %8.1fx realtime  %s\n", chain.name.c_str(), chain.channels, chain.wallSeconds, seconds / chain.wallSeconds, chain.path.c_str());
+	}
+	std::printf("Rendered %zu chain(s) of %g s at %g Hz on %d thread(s) in %.2f s, %.1fx realtime\n", chains.size(), seconds, sampleRate, threads, wallSeconds, chains.size() * seconds / wallSeconds);
+	return failures ? 1 : 0;
+}
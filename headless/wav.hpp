@@ -0,0 +1,162 @@
+#pragma once
+// 32-bit float WAV files, for the renders of the headless tools.
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+namespace headless {
+
+
+struct Wav {
+	int channels = 1;
+	int sampleRate = 48000;
+	std::vector<float> samples; // Interleaved frames
+
+	int64_t frames() const {
+		return channels ? int64_t(samples.size()) / channels : 0;
+	}
+
+	float get(int64_t frame, int channel) const {
+		return samples[frame * channels + channel];
+	}
+
+	bool write(const std::string& path) const {
+		FILE* file = std::fopen(path.c_str(), "wb");
+		if (!file)
+			return false;
+		writeHeader(file, channels, sampleRate, samples.size() * sizeof(float));
+		size_t written = std::fwrite(samples.data(), sizeof(float), samples.size(), file);
+		return (std::fclose(file) == 0) && written == samples.size();
+	}
+
+	/** Reads 32-bit float files like the ones write() makes. Returns false for anything else. */
+	bool read(const std::string& path) {
+		FILE* file = std::fopen(path.c_str(), "rb");
+		if (!file)
+			return false;
+		bool ok = readChunks(file);
+		std::fclose(file);
+		return ok;
+	}
+
+	/** Writes the 44 byte header of a file with `dataSize` bytes of samples */
+	static void writeHeader(FILE* file, int channels, int sampleRate, uint32_t dataSize) {
+		uint16_t blockAlign = channels * sizeof(float);
+		writeTag(file, "RIFF");
+		write32(file, 4 + 8 + 16 + 8 + dataSize);
+		writeTag(file, "WAVE");
+		writeTag(file, "fmt ");
+		write32(file, 16);
+		write16(file, 3); // IEEE float
+		write16(file, channels);
+		write32(file, sampleRate);
+		write32(file, sampleRate * blockAlign);
+		write16(file, blockAlign);
+		write16(file, 32);
+		writeTag(file, "data");
+		write32(file, dataSize);
+	}
+
+private:
+	bool readChunks(FILE* file) {
+		char tag[4];
+		uint32_t size;
+		if (!readTag(file, tag) || std::memcmp(tag, "RIFF", 4) || !read32(file, &size) || !readTag(file, tag) || std::memcmp(tag, "WAVE", 4))
+			return false;
+		bool format = false;
+		while (readTag(file, tag) && read32(file, &size)) {
+			if (!std::memcmp(tag, "fmt ", 4)) {
+				uint16_t type, count, align, bits;
+				uint32_t rate, byteRate;
+				if (size < 16 || !read16(file, &type) || !read16(file, &count) || !read32(file, &rate) || !read32(file, &byteRate) || !read16(file, &align) || !read16(file, &bits))
+					return false;
+				if (type != 3 || bits != 32 || count == 0)
+					return false;
+				channels = count;
+				sampleRate = rate;
+				format = true;
+				std::fseek(file, size - 16 + (size & 1), SEEK_CUR);
+			}
+			else if (!std::memcmp(tag, "data", 4)) {
+				if (!format)
+					return false;
+				samples.resize(size / sizeof(float));
+				return std::fread(samples.data(), sizeof(float), samples.size(), file) == samples.size();
+			}
+			else {
+				std::fseek(file, size + (size & 1), SEEK_CUR);
+			}
+		}
+		return false;
+	}
+
+	// WAV is little-endian, like every platform Rack runs on
+	static void writeTag(FILE* file, const char* tag) {std::fwrite(tag, 1, 4, file);}
+	static void write16(FILE* file, uint16_t x) {std::fwrite(&x, 2, 1, file);}
+	static void write32(FILE* file, uint32_t x) {std::fwrite(&x, 4, 1, file);}
+	static bool readTag(FILE* file, char* tag) {return std::fread(tag, 1, 4, file) == 4;}
+	static bool read16(FILE* file, uint16_t* x) {return std::fread(x, 2, 1, file) == 1;}
+	static bool read32(FILE* file, uint32_t* x) {return std::fread(x, 4, 1, file) == 1;}
+};
+
+
+/** Streams frames to a file in the format of Wav::write(), for renders too long to keep in memory.
+The header is rewritten with the final sizes on close().
+*/
+struct WavWriter {
+	FILE* file = NULL;
+	int channels = 0;
+	int64_t frames = 0;
+	bool failed = false;
+
+	~WavWriter() {
+		close();
+	}
+
+	bool open(const std::string& path, int channels, int sampleRate) {
+		file = std::fopen(path.c_str(), "wb");
+		if (!file)
+			return false;
+		this->channels = channels;
+		frames = 0;
+		failed = false;
+		Wav::writeHeader(file, channels, sampleRate, 0);
+		return true;
+	}
+
+	/** Writes `count` interleaved frames */
+	void write(const float* samples, int64_t count) {
+		if (!file || count <= 0)
+			return;
+		if (std::fwrite(samples, sizeof(float) * channels, count, file) != size_t(count))
+			failed = true;
+		frames += count;
+	}
+
+	/** Patches the sizes into the header and closes the file. Returns false if anything failed to be written. */
+	bool close() {
+		if (!file)
+			return !failed;
+		// Sizes are 32-bit, which is about 3 hours of stereo at 48 kHz
+		uint64_t dataSize = uint64_t(frames) * channels * sizeof(float);
+		if (dataSize > UINT32_MAX - 36)
+			failed = true;
+		uint32_t size = std::min<uint64_t>(dataSize, UINT32_MAX - 36);
+		std::fseek(file, 4, SEEK_SET);
+		uint32_t riffSize = 36 + size;
+		std::fwrite(&riffSize, 4, 1, file);
+		std::fseek(file, 40, SEEK_SET);
+		std::fwrite(&size, 4, 1, file);
+		if (std::fclose(file) != 0)
+			failed = true;
+		file = NULL;
+		return !failed;
+	}
+};
+
+
+} // namespace headless
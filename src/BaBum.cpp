@@ -1,4 +1,5 @@
 #include "plugin.hpp"
+#include "oversampler.hpp"
 #include <string>
 
 const int PARTS = 5;
@@ -63,18 +64,47 @@ struct BaBum : Module {
 	float BASE_FREQ = 10; // Base freq in Hz for oscs
 	float REST_STATE = 4.0f; // Fraction of a second to define rest threshold for triggers
 
-	float oscRamps[PARTS] = {0.f, 0.f, 0.f, 0.f, 0.f}; // Register ramp state for oscs
-	float ampRamps[PARTS] = {0.f, 0.f, 0.f, 0.f, 0.f}; // Register ramp state for amps
-	float ampRatio[PARTS] = {5.f, 5.f, 5.f, 5.f, 5.f}; // Fraction of a second to define length of each amp
+	// Voice state per part, one SIMD lane per polyphonic channel
+	simd::float_4 oscRamps[PARTS][PORT_MAX_CHANNELS / 4] = {}; // Register ramp state for oscs
+	simd::float_4 ampRamps[PARTS][PORT_MAX_CHANNELS / 4] = {}; // Register ramp state for amps
+	simd::float_4 pulseRemaining[PARTS][PORT_MAX_CHANNELS / 4] = {}; // Gate time left, like dsp::PulseGenerator
+	simd::float_4 triggerRestStates[PARTS][PORT_MAX_CHANNELS / 4] = {}; // Rest state counter before rettriger can happen
 	float triggerPrevStates[PARTS] = {0.f, 0.f, 0.f, 0.f, 0.f}; // Previous state of trigger to avoid fast retriggering
-	float triggerRestStates[PARTS] = {0.f, 0.f, 0.f, 0.f, 0.f}; // Rest state counter before rettriger can happen
 
-	dsp::PulseGenerator pgens[PARTS];
-	dsp::SchmittTrigger edgeDetectors[PARTS];
+	dsp::TSchmittTrigger<simd::float_4> edgeDetectors[PARTS][PORT_MAX_CHANNELS / 4];
 	dsp::RCFilter noiseFilter;
+	float noise = 0.f; // White noise of the current sample, for the snare
+	float filteredNoise = 0.f; // High-passed noise of the current sample, for the hihats
+	bool noiseReady = false;
+	SeededRandom rng;
+
+	// Parts without a trigger cable play the matching Secu track when a Secu is adjacent, through the transport
+	TransportLink link;
 
 	ParamId TRIGGERS_PARAM[PARTS] = {TRIGBD_PARAM, TRIGSNR_PARAM, TRIGHH_PARAM, TRIGHHO_PARAM, TRIGFX_PARAM};
 	ParamId LENGTHS_PARAM[PARTS] = {LENGTHBD_PARAM, LENGTHSNR_PARAM, LENGTHHH_PARAM, LENGTHHH_PARAM, LENGTHFX_PARAM};
+	ParamId DRIVES_PARAM[PARTS] = {PARAMBD_PARAM, PARAMSNR_PARAM, PARAMHH_PARAM, PARAMHH_PARAM, PARAMFX_PARAM};
+	ParamId TUNES_PARAM[PARTS] = {TUNEBD_PARAM, TUNESNR_PARAM, TUNEHH_PARAM, TUNEHH_PARAM, TUNEFX_PARAM};
+	InputId TUNES_INPUT[PARTS] = {TUNEBD_INPUT, TUNESNR_INPUT, TUNEHH_INPUT, TUNEHH_INPUT, TUNEFX_INPUT};
+	float TUNE_OFFSETS[PARTS] = {50.f, 100.f, 0.f, 0.f, 80.f}; // Osc phase at the end of the sweep is tune * range + offset radians
+	float TUNE_RANGES[PARTS] = {200.f, 100.f, 0.f, 0.f, 1000.f};
+
+	// Knobs and CV polled at control rate
+	ControlRate controlRate;
+	ProcessTimer timer;
+	float triggerValues[PARTS] = {};
+	float gateRatios[PARTS] = {};
+	float drives[PARTS] = {};
+	SmoothedControl mixLevels[PARTS];
+	TSmoothedControl<simd::float_4> oscScales[PARTS][PORT_MAX_CHANNELS / 4]; // Osc cycles over the whole sweep
+	int polledChannels[PARTS] = {};
+
+	LightRate lightRate;
+	LightPeak partPeaks[PARTS]; // Loudest voice envelope of each part
+
+	// The drive stage of the oscillators runs at `oversampling` times the sample rate, set from the context menu
+	int oversampling = 1;
+	TOversampler<simd::float_4> oversamplers[PARTS][PORT_MAX_CHANNELS / 4];
 
 	BaBum() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
@@ -121,98 +151,220 @@ struct BaBum : Module {
 		configOutput(HHO_OUTPUT, "HiHat Open");
 		configOutput(FX_OUTPUT, "FX Sound");
 		configOutput(MIX_OUTPUT, "Mix");
+
+		link.setup(this);
 	}
 
-	void process(const ProcessArgs& args) override {
+	void onSampleRateChange(const SampleRateChangeEvent& e) override {
+		controlRate.invalidate();
+	}
+
+	json_t* dataToJson() override {
+		json_t* rootJ = json_object();
+		json_object_set_new(rootJ, "oversampling", json_integer(oversampling));
+		rng.dataToJson(rootJ);
+		return rootJ;
+	}
+
+	void dataFromJson(json_t* rootJ) override {
+		json_t* oversamplingJ = json_object_get(rootJ, "oversampling");
+		if (oversamplingJ)
+			oversampling = clamp((int) json_integer_value(oversamplingJ), 1, TOversampler<>::MAX_FACTOR);
+		rng.dataFromJson(rootJ);
+	}
+
+	/** Hard clips the driven oscillator, at the oversampled rate */
+	simd::float_4 drive(int i, int g, simd::float_4 osc) {
+		return oversamplers[i][g].process(osc * drives[i], [](simd::float_4 x) {
+			return simd::clamp(x, -1.0f, 1.0f);
+		});
+	}
 
-		float noise = (random::uniform() - 0.5) * 2;
+	/** Short linear attack into `decay`, the part's decay curve: (1 - ampRamp + CLIP_RATIO) raised to some power. */
+	simd::float_4 envelope(simd::float_4 ampRamp, simd::float_4 decay) {
+		return simd::clamp(simd::ifelse(ampRamp < CLIP_RATIO, ampRamp / CLIP_RATIO, decay), 0.f, 1.f);
+	}
+
+	void pollNoise(const ProcessArgs& args) {
 		float noiseTune = params[TUNEHH_PARAM].getValue() + (inputs[TUNEBD_INPUT].getVoltage() * 1000);
 		noiseFilter.setCutoff(noiseTune / args.sampleRate);
+	}
+
+	void pollPart(int i, int channels) {
+		triggerValues[i] = params[TRIGGERS_PARAM[i]].getValue();
+		gateRatios[i] = 7.f - params[LENGTHS_PARAM[i]].getValue();
+		drives[i] = params[DRIVES_PARAM[i]].getValue();
+		mixLevels[i].setTarget(params[MIXBD_PARAM + i].getValue(), controlRate.getDivision());
+
+		for (int c = 0; c < channels; c += 4)
+			oversamplers[i][c / 4].setFactor(oversampling);
+
+		if (TUNE_RANGES[i] == 0.f) {
+			polledChannels[i] = channels;
+			return;
+		}
+		float tune = params[TUNES_PARAM[i]].getValue();
+		for (int c = 0; c < channels; c += 4) {
+			int g = c / 4;
+			simd::float_4 cv = simd::clamp(inputs[TUNES_INPUT[i]].getPolyVoltageSimd<simd::float_4>(c) / 10.f, 0.f, 1.f);
+			simd::float_4 scale = (simd::clamp(tune + cv, 0.f, 1.f) * TUNE_RANGES[i] + TUNE_OFFSETS[i]) * (0.5f / M_PI); // In cycles
+			if (c < polledChannels[i])
+				oscScales[i][g].setTarget(scale, controlRate.getDivision());
+			else
+				oscScales[i][g].reset(scale);
+		}
+		polledChannels[i] = channels;
+	}
+
+	/** Draws the noise of the current sample. Only sounding snare and hihat voices ask for it, so it's skipped otherwise. */
+	void makeNoise() {
+		if (noiseReady)
+			return;
+		noise = rng.uniform() * 2.f - 1.f;
 		noiseFilter.process(noise);
-		float filteredNoise = noiseFilter.highpass();
+		filteredNoise = noiseFilter.highpass();
+		noiseReady = true;
+	}
+
+	/** Advances the voices of part `i` in channels c to c + 3 and returns their output voltages. */
+	simd::float_4 processVoices(int i, int c, float mixLevel, bool linkFire, const ProcessArgs& args, simd::float_4* amp) {
+		int g = c / 4;
+		float gateRatio = gateRatios[i];
+
+		simd::float_4 fire = 0.f;
+		if (inputs[BD_INPUT + i].isConnected())
+			fire = edgeDetectors[i][g].process(inputs[BD_INPUT + i].getVoltageSimd<simd::float_4>(c));
+		if (linkFire || triggerValues[i] >= 0.01)
+			fire = simd::float_4::mask();
+		if (simd::movemask(fire)) {
+			// Trigger if more than 0
+			simd::float_4 ready = (triggerPrevStates[i] == 0.0f) ? simd::float_4::mask() : (triggerRestStates[i][g] <= 0.0f);
+			simd::float_4 start = fire & ready;
+			simd::float_4 rest = fire & ~ready;
+			oscRamps[i][g] = simd::ifelse(start, 0.f, oscRamps[i][g]);
+			ampRamps[i][g] = simd::ifelse(start, 0.f, ampRamps[i][g]);
+			pulseRemaining[i][g] = simd::ifelse(start, simd::fmax(pulseRemaining[i][g], 1.0f / gateRatio), pulseRemaining[i][g]);
+			triggerRestStates[i][g] = simd::ifelse(start, args.sampleRate / REST_STATE, triggerRestStates[i][g]);
+			triggerRestStates[i][g] = simd::ifelse(rest, simd::clamp(triggerRestStates[i][g] - 1.f, 0.0f, args.sampleRate), triggerRestStates[i][g]);
+		}
+
+		// A voice is silent from the end of its gate until the next trigger, so skip groups with no voice sounding
+		if (!simd::movemask(pulseRemaining[i][g] > 0.f)) {
+			oscScales[i][g].reset(oscScales[i][g].target);
+			*amp = 0.f;
+			return 0.f;
+		}
+		if (i >= 1 && i <= 3)
+			makeNoise();
+
+		// osc and ramps update
+		ampRamps[i][g] = simd::fmin(ampRamps[i][g] + args.sampleTime * gateRatio, 1.f); // Cycles per second
+		oscRamps[i][g] = simd::fmin(oscRamps[i][g] + args.sampleTime * BASE_FREQ, 1.f); // amp Set to one so it doesnt make an abrupt noise
+
+		simd::float_4 pgenState = simd::ifelse(pulseRemaining[i][g] > 0.f, 1.f, 0.f);
+		pulseRemaining[i][g] = simd::ifelse(pulseRemaining[i][g] > 0.f, pulseRemaining[i][g] - args.sampleTime, pulseRemaining[i][g]);
+
+		// The osc phase follows a pitch sweep curve of the osc ramp: sqrt for the drums, which fall in pitch, and
+		// ramp^1.5 for the FX sound, which rises. Envelopes decay along integer powers of the amp ramp.
+		simd::float_4 osc = oscRamps[i][g];
+		simd::float_4 decay = 1.f - ampRamps[i][g] + CLIP_RATIO;
+		simd::float_4 decay2 = decay * decay;
+		simd::float_4 mix = 0.f;
+
+		// Specific code for each instrument
+		if (i == 0) {
+			*amp = envelope(ampRamps[i][g], decay2);
+			simd::float_4 o = drive(i, g, fastmath::sin2pi(simd::sqrt(osc) * oscScales[i][g].process()));
+			mix = o * *amp * mixLevel; // First part is the osc, second part is the amp then the mixer volume
+		}
+
+		if (i == 1) {
+			*amp = envelope(ampRamps[i][g], decay2);
+			simd::float_4 amp2 = decay2 * decay2 * decay2;
+			simd::float_4 o = drive(i, g, fastmath::sin2pi(simd::sqrt(osc) * oscScales[i][g].process()));
+			mix = ((o * *amp) + (noise * 0.5f * amp2)) * mixLevel; // First part is the osc, second part is the amp then the mixer volume
+		}
+
+		if (i == 2) {
+			simd::float_4 decay4 = decay2 * decay2;
+			*amp = envelope(ampRamps[i][g], decay4 * decay4 * decay2);
+			mix = filteredNoise * *amp * mixLevel; // First part is the osc, second part is the amp then the mixer volume
+		}
+
+		if (i == 3) {
+			*amp = envelope(ampRamps[i][g], decay2);
+			mix = filteredNoise * *amp * mixLevel; // First part is the osc, second part is the amp then the mixer volume
+		}
+
+		if (i == 4) {
+			simd::float_4 o = drive(i, g, fastmath::sin2pi(osc * simd::sqrt(osc) * oscScales[i][g].process()));
+			*amp = envelope(ampRamps[i][g], decay2);
+			mix = o * *amp * mixLevel; // First part is the osc, second part is the amp then the mixer volume
+		}
+
+		return mix * 10.f * pgenState;
+	}
+
+	void process(const ProcessArgs& args) override {
+		ProcessTimer::Scope timing(timer);
+		bool poll = controlRate.process();
+		if (poll)
+			pollNoise(args);
+
+		noiseReady = false;
+
+		bool linked = link.receive(this, args.frame);
+		bool followGates = linked && link.transport.gatesTick >= 0;
+		int linkGates = (followGates && link.gates(args.frame)) ? link.transport.gates : 0;
 
 		float connectedInputs = 0.f;
-		float generalMix = 0.f;
+		simd::float_4 generalMix[PORT_MAX_CHANNELS / 4] = {};
+		float monoMix = 0.f; // Mono parts are mixed into every voice
+		int mixChannels = 1;
 
 		for (int i = 0; i < PARTS; i++) {
-			lights[LIGHTBD_LIGHT + i].setBrightness(0.f);
-			if (!inputs[BD_INPUT + i].isConnected()) continue;
+			bool patched = inputs[BD_INPUT + i].isConnected();
+			if (!patched && !followGates) continue;
 			connectedInputs += 1.f;
 
-			float triggerValue = params[TRIGGERS_PARAM[i]].getValue();
-			float gateRatio = 7.f - params[LENGTHS_PARAM[i]].getValue();
-
-			if (triggerValue >= 0.01 || edgeDetectors[i].process(inputs[BD_INPUT+i].getVoltage())) {
-				// Trigger if more than 0
-				if (triggerPrevStates[i] == 0.0f || triggerRestStates[i] <= 0.0f) {
-					oscRamps[i] = 0.0f;
-					ampRamps[i] = 0.0f;
-					pgens[i].trigger(1.0f / gateRatio);
-					triggerRestStates[i] = args.sampleRate / REST_STATE;
-				} else {
-					triggerRestStates[i]--;
-					triggerRestStates[i] = clamp(triggerRestStates[i], 0.0f, args.sampleRate);
-				}
-			}
-			triggerPrevStates[i] = triggerValue; // Reset prev state of triggers
-
-			// osc and ramps update
-			ampRamps[i] += args.sampleTime * gateRatio; // Cycles per second
-			if (ampRamps[i] >= 1.f)
-				ampRamps[i] = 1.f; // -= 1.f to reset
-
-			oscRamps[i] += args.sampleTime * BASE_FREQ; // Cycles per second
-			if (oscRamps[i] >= 1.f)
-				oscRamps[i] = 1.f; // amp Set to one so it doesnt make an abrupt noise
-
-			float pgenState = pgens[i].process(args.sampleTime);
-			float amp;
-			float mix;
-
-			// Specific code for each instrument
-			if (i == 0) {
-				float tune = clamp(params[TUNEBD_PARAM].getValue() + clamp(inputs[TUNEBD_INPUT].getVoltage() / 10.f, 0.f, 1.f), 0.f, 1.f);
-				float drive = params[PARAMBD_PARAM].getValue(); // This could be another param
-				amp = clamp(ampRamps[i] < CLIP_RATIO ? ampRamps[i] / CLIP_RATIO : pow(1 - ampRamps[i] + CLIP_RATIO, 2), 0.0f, 1.0f);
-				float osc = clamp(sin(sqrt(oscRamps[i]) * ((tune * 200) + 50)) * drive, -1.0f, 1.0f);
-				mix = osc * amp * params[MIXBD_PARAM].getValue(); ; // First part is the osc, second part is the amp then the mixer volume
-			}
+			int channels = patched ? inputs[BD_INPUT + i].getChannels() : 1;
+			mixChannels = std::max(mixChannels, channels);
+			outputs[BD_OUTPUT + i].setChannels(channels);
 
-			if (i == 1) {
-				float tune = clamp(params[TUNESNR_PARAM].getValue() + clamp(inputs[TUNESNR_INPUT].getVoltage() / 10.f, 0.f, 1.f), 0.f, 1.f);
-				float drive = params[PARAMSNR_PARAM].getValue(); // This could be another param
-				amp = clamp(ampRamps[i] < CLIP_RATIO ? ampRamps[i] / CLIP_RATIO : pow(1 - ampRamps[i] + CLIP_RATIO, 2), 0.0f, 1.0f);
-				float amp2 = pow(1 - ampRamps[i] + CLIP_RATIO, 6);
-				float osc = clamp(sin(sqrt(oscRamps[i]) * ((tune * 100) + 100)) * drive, -1.0f, 1.0f);
-				mix = ((osc * amp) + (noise * 0.5 * amp2)) * params[MIXSNR_PARAM].getValue(); ; // First part is the osc, second part is the amp then the mixer volume
-			}
+			// Newly patched voices can't wait for the next poll
+			if (poll || channels > polledChannels[i])
+				pollPart(i, channels);
 
-			if (i == 2) {
-				amp = clamp(ampRamps[i] < CLIP_RATIO ? ampRamps[i] / CLIP_RATIO : pow(1 - ampRamps[i] + CLIP_RATIO, 10), 0.0f, 1.0f);
-				mix = filteredNoise * amp * params[MIXHH_PARAM].getValue(); ; // First part is the osc, second part is the amp then the mixer volume
-			}
+			float mixLevel = mixLevels[i].process();
 
-			if (i == 3) {
-				amp = clamp(ampRamps[i] < CLIP_RATIO ? ampRamps[i] / CLIP_RATIO : pow(1 - ampRamps[i] + CLIP_RATIO, 2), 0.0f, 1.0f);
-				mix = filteredNoise * amp * params[MIXHHO_PARAM].getValue(); ; // First part is the osc, second part is the amp then the mixer volume
-			}
+			for (int c = 0; c < channels; c += 4) {
+				simd::float_4 amp = 0.f;
+				simd::float_4 mixV = processVoices(i, c, mixLevel, !patched && (linkGates & (1 << i)), args, &amp);
 
-			if (i == 4) {
-				float tune = clamp(params[TUNEFX_PARAM].getValue() + clamp(inputs[TUNEFX_INPUT].getVoltage() / 10.f, 0.f, 1.f), 0.f, 1.f);
-				float drive = params[PARAMFX_PARAM].getValue(); // This could be another param
-				float osc = clamp(sin(sqrt(oscRamps[i] * oscRamps[i] * oscRamps[i]) * ((tune * 1000) + 80)) * drive, -1.0f, 1.0f);
-				amp = clamp(ampRamps[i] < CLIP_RATIO ? ampRamps[i] / CLIP_RATIO : pow(1 - ampRamps[i] + CLIP_RATIO, 2), 0.0f, 1.0f);
-				mix = osc * amp * params[MIXFX_PARAM].getValue(); ; // First part is the osc, second part is the amp then the mixer volume
-			}
+				if (channels == 1)
+					monoMix += mixV[0];
+				else
+					generalMix[c / 4] += mixV;
 
-			float mixV = mix * 10.f * pgenState;
+				outputs[BD_OUTPUT + i].setVoltageSimd(mixV, c);
+				for (int l = 0; l < 4 && c + l < channels; l++)
+					partPeaks[i].hold(amp[l]);
+			}
+			triggerPrevStates[i] = triggerValues[i]; // Reset prev state of triggers
+		}
 
-			generalMix += mixV;
+		if (lightRate.process()) {
+			for (int i = 0; i < PARTS; i++)
+				lights[LIGHTBD_LIGHT + i].setBrightness(partPeaks[i].take());
+		}
 
-			outputs[BD_OUTPUT + i].setVoltage(mixV);
-			lights[LIGHTBD_LIGHT + i].setBrightness(amp);
+		outputs[MIX_OUTPUT].setChannels(mixChannels);
+		for (int c = 0; c < mixChannels; c += 4) {
+			outputs[MIX_OUTPUT].setVoltageSimd((generalMix[c / 4] + monoMix) / (connectedInputs + 0.0000000001f), c);
 		}
-		outputs[MIX_OUTPUT].setVoltage(generalMix / (connectedInputs + 0.0000000001));
+
+		if (linked)
+			link.forward(this, link.transport, args.frame);
 	}
 };
 
@@ -222,8 +374,11 @@ struct BaBumWidget : ModuleWidget {
 		setModule(module);
 		setPanel(createPanel(asset::plugin(pluginInstance, "res/BaBum.svg")));
 
+		LabelLayer* labels = new LabelLayer(box.size);
+		addChild(labels);
+
 		float hp = 5.08f;
-		addChild(new TextDisplayWidget("BaBum", Vec(hp/2, hp*1.5), 14, -1));
+		labels->addLabel("BaBum", Vec(hp/2, hp*1.5), 14, -1);
 		addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, 0)));
 		addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
 
@@ -245,7 +400,7 @@ struct BaBumWidget : ModuleWidget {
 
 		std::string CONTROLS[3] = {"Tune", "Len", "Char"};
 		for (int i = 1; i < PARTS - 1; i++) {
-			addChild(new TextDisplayWidget(CONTROLS[i - 1], Vec(5.08f * 2, ControlsY + (SepY * i)), 9, 1));
+			labels->addLabel(CONTROLS[i - 1], Vec(5.08f * 2, ControlsY + (SepY * i)), 9, 1);
 		}
 
 		float minX5 = 7.5f;
@@ -259,19 +414,31 @@ struct BaBumWidget : ModuleWidget {
 		std::string NAMES[PARTS] = {"Kck", "Snr", "HhC", "HhO", "Fx"};
 
 		for (int i = 0; i < 5; i++) {
-			addChild(new TextDisplayWidget(NAMES[i], Vec(minX5 + (div5 * float(i)), triggerY - 5.f), 13));
+			labels->addLabel(NAMES[i], Vec(minX5 + (div5 * float(i)), triggerY - 5.f), 13);
 			addChild(createLightCentered<MediumLight<RedLight>>(mm2px(Vec(minX5 + (div5 * float(i)), triggerY)), module, BaBum::LIGHTBD_LIGHT + i));
 			addParam(createParamCentered<VCVButton>(mm2px(Vec(minX5 + (div5 * float(i)), triggerY)), module, BaBum::TRIGBD_PARAM + i));
 			addInput(createInputCentered<PJ301MPort>(mm2px(Vec(minX5 + (div5 * float(i)), triggerY + 8.f)), module, BaBum::BD_INPUT + i));
 			addParam(createParamCentered<RoundSmallBlackKnob>(mm2px(Vec(minX5 + (div5 * float(i)), mixY)), module, BaBum::MIXBD_PARAM + i));
 			addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(minX5 + (div5 * float(i)), outY)), module, BaBum::BD_OUTPUT + i));
 		}
-		addChild(new TextDisplayWidget("Mixer", Vec(minX5 + (div5 * 2), mixY - 7.f), 14));
+		labels->addLabel("Mixer", Vec(minX5 + (div5 * 2), mixY - 7.f), 14);
 
 		// TextDisplayWidget* mixText; // Para tener la variable
-		addChild(new TextDisplayWidget("All", Vec((minX5 + div5 * 2) - 5.f, outY + 10.f), 10, 1));
+		labels->addLabel("All", Vec((minX5 + div5 * 2) - 5.f, outY + 10.f), 10, 1);
 		addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(minX5 + (div5 * 2), outY + 10.f)), module, BaBum::MIX_OUTPUT));		
 	}
+
+	void appendContextMenu(Menu* menu) override {
+		BaBum* module = getModule<BaBum>();
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createIndexSubmenuItem("Drive oversampling", OVERSAMPLING_LABELS,
+			[=]() {return oversamplingIndex(module->oversampling);},
+			[=](size_t i) {module->oversampling = 1 << i;}
+		));
+		module->rng.appendContextMenu(menu);
+		module->timer.appendContextMenu(menu, module);
+	}
 };
 
 
@@ -1,9 +1,332 @@
 #include "plugin.hpp"
+#include "oversampler.hpp"
+
+#include <atomic>
+#include <mutex>
 
 const int EFFECTSNR = 5;
 const int PARAMSNR = 3; // Quantity, CV Attenuation, dry/wet
 const std::string NAMES[EFFECTSNR] = {"Bitcrush", "Decimate", "Distort", "Glitch", "Crop"};
-const int MAXGLITCHSAMPLES = (int)(48000 / 2);
+const std::vector<float> GLITCH_SECONDS = {0.25f, 0.5f, 1.f, 2.f}; // Choices for the longest glitch
+const float DEFAULT_GLITCH_SECONDS = 0.5f;
+const int MAX_GLITCH_GRAINS = 8; // Grains a channel can play at once, in float_4s
+const std::vector<int> GLITCH_GRAINS = {1, 2, 4, 8}; // Choices for the grains at full quantity
+const int DEFAULT_GLITCH_GRAINS = 4;
+const float GLITCH_CHANCE = 0.001f; // Chance of a grain starting on a sample, at full quantity
+const float GLITCH_RATES[] = {1.f, 1.f, -1.f, 0.5f, 2.f}; // Playback rates grains pick from
+const std::string SPECTRAL_NAME = "Spectral"; // Runs on the Glitch row instead of Glitch, picked from the context menu
+const std::vector<std::string> SPECTRAL_MODES = {"Freeze", "Bin shuffle", "Spectral decimate"};
+const std::vector<int> SPECTRAL_SIZES = {256, 512, 1024, 2048}; // FFT sizes, each its own latency in samples
+const int DEFAULT_SPECTRAL_SIZE = 1024;
+
+// In chain mode the effects run one after the other, in an order packed 3 bits per position into one int so the menu
+// can change it in a single write. Effect 0 is in the lowest bits.
+inline int chainOrderEffect(int chainOrder, int position) {
+	return (chainOrder >> (3 * position)) & 7;
+}
+inline int setChainOrderEffect(int chainOrder, int position, int effect) {
+	return (chainOrder & ~(7 << (3 * position))) | (effect << (3 * position));
+}
+const int DEFAULT_CHAIN_ORDER = 0 | (1 << 3) | (2 << 6) | (3 << 9) | (4 << 12);
+
+/** Recorded input that Glitch plays grains from, one circular region of `length` samples per channel */
+struct GlitchBuffer {
+	int channels;
+	int length;
+	std::vector<float> samples;
+
+	GlitchBuffer(int channels, int length) : channels(channels), length(length), samples(channels * length, 0.f) {}
+
+	float* region(int c) {
+		return &samples[c * length];
+	}
+};
+
+/** Hands buffers over to process(), which mustn't allocate. process() asks for a size with request(), update() builds
+the buffer on the UI thread and leaves it in `pending`, and take() swaps it in, leaving the one it replaced in
+`retired` for the next update() to free. T is built from a channel count and a length, and has both as members.
+*/
+template <typename T>
+struct BufferHandoff {
+	T* buffer = NULL; // Owned by process()
+	int channels = 0; // Size process() wants, mirrored in request*
+	int length = 0;
+	std::atomic<int> requestChannels{0};
+	std::atomic<int> requestLength{0};
+	std::atomic<T*> pending{NULL};
+	std::atomic<T*> retired{NULL};
+	std::mutex mutex; // Only taken by update(), never by process()
+	int builtChannels = 0; // Size of the last buffer update() built
+	int builtLength = 0;
+
+	~BufferHandoff() {
+		delete buffer;
+		delete pending.load();
+		delete retired.load();
+	}
+
+	/** Asks for a buffer of `channels` channels of `length`. Called by process() and the events. */
+	void request(int channels, int length) {
+		if (channels == this->channels && length == this->length)
+			return;
+		this->channels = channels;
+		this->length = length;
+		requestChannels.store(channels);
+		requestLength.store(length);
+	}
+
+	/** Builds the requested buffer and frees retired ones. Called by the module widget on the UI thread. */
+	void update(bool wait = false) {
+		std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+		if (wait)
+			lock.lock();
+		else if (!lock.try_lock())
+			return;
+
+		delete retired.exchange(NULL);
+		if (pending.load())
+			return;
+		int channels = requestChannels.load();
+		int length = requestLength.load();
+		if (channels == builtChannels && length == builtLength)
+			return;
+		pending.store(new T(channels, length));
+		builtChannels = channels;
+		builtLength = length;
+	}
+
+	/** Swaps in the buffer built by update() if it has the requested size. Called by process(). Returns true if it
+	did, and the state that goes with the buffer has to start over.
+	*/
+	bool take() {
+		if (!pending.load() || retired.load())
+			return false;
+		T* next = pending.exchange(NULL);
+		bool fits = next->channels == channels && next->length == length;
+		if (fits)
+			std::swap(next, buffer);
+		retired.store(next);
+		return fits;
+	}
+};
+
+/** Buffers and state of the Spectral effect: Hann windowed frames of `length` samples, a quarter of a frame apart,
+go through an FFT, get corrupted as spectra and are added back together. That delays the whole effect, dry signal
+included, by `length` samples, and costs two FFTs per channel every `length / 4` samples.
+*/
+struct Spectral {
+	enum Mode {
+		FREEZE,
+		SHUFFLE,
+		DECIMATE,
+	};
+
+	struct Channel {
+		float* input; // The last `length` samples, the oldest first
+		float* output; // Frames added up. The first `length / 4` samples are complete.
+		float* frozen; // Freeze: the held spectrum, for its phases
+		float* frozenMagnitudes; // Freeze: the held magnitudes
+		int hop; // Samples into the current hop
+	};
+
+	int channels;
+	int length; // FFT size, one of SPECTRAL_SIZES
+	std::vector<simd::float_4> storage; // Every array below, as float_4s so each starts 16-byte aligned for the FFT
+	std::vector<Channel> state;
+	// Shared by the channels, which take turns
+	float* frame = NULL;
+	float* spectrum = NULL;
+	float* dry = NULL;
+	float* analysis = NULL;
+	float* synthesis = NULL;
+	float* magnitudes = NULL;
+	float* gains = NULL;
+	std::unique_ptr<dsp::RealFFT> fft;
+
+	/** Allocates everything for `channels` channels of frames of `length` samples, or nothing for 0 channels */
+	Spectral(int channels, int length) : channels(channels), length(length), state(channels) {
+		if (channels == 0)
+			return;
+		// Per channel 3 arrays of `length` and one of half, shared 5 of `length` and 2 of half
+		storage.resize(((channels * 7 + 12) * length / 2) / 4, simd::float_4(0.f));
+		float* next = (float*) storage.data();
+		auto carve = [&](int n) {
+			float* p = next;
+			next += n;
+			return p;
+		};
+		int hop = length / 4;
+		for (int c = 0; c < channels; c++) {
+			Channel& ch = state[c];
+			ch.input = carve(length);
+			ch.output = carve(length);
+			ch.frozen = carve(length);
+			ch.frozenMagnitudes = carve(length / 2);
+			// Channels take their frames on different samples, to spread the FFTs out
+			ch.hop = c * hop / PORT_MAX_CHANNELS;
+		}
+		frame = carve(length);
+		spectrum = carve(length);
+		dry = carve(length);
+		analysis = carve(length);
+		synthesis = carve(length);
+		magnitudes = carve(length / 2);
+		gains = carve(length / 2);
+		fft.reset(new dsp::RealFFT(length));
+
+		// Hann windows a quarter apart add up to 1.5 when squared. The synthesis window also undoes that and the
+		// scale of the inverse FFT.
+		for (int k = 0; k < length; k += 4) {
+			simd::float_4 phase = (simd::float_4(0.f, 1.f, 2.f, 3.f) + k) / length;
+			simd::float_4 window = 0.5f - 0.5f * fastmath::cos2pi(phase);
+			window.store(analysis + k);
+			(window / (1.5f * length)).store(synthesis + k);
+		}
+	}
+
+	/** Takes a sample of channel `c` and returns the one from `length` samples ago, corrupted by `quantity` and mixed
+	with its dry signal by `dw`
+	*/
+	float process(float x, int c, float quantity, float dw, int mode, Random& rng) {
+		Channel& ch = state[c];
+		int hop = length / 4;
+		ch.input[length - hop + ch.hop] = x;
+		float y = ch.output[ch.hop];
+		if (++ch.hop == hop) {
+			ch.hop = 0;
+			processFrame(ch, quantity, dw, mode, rng);
+		}
+		return y;
+	}
+
+	void processFrame(Channel& ch, float quantity, float dw, int mode, Random& rng) {
+		int hop = length / 4;
+		for (int k = 0; k < length; k += 4)
+			(simd::float_4::load(ch.input + k) * simd::float_4::load(analysis + k)).store(frame + k);
+		fft->rfft(frame, spectrum);
+		std::memcpy(dry, spectrum, length * sizeof(float));
+
+		if (mode == FREEZE)
+			freeze(ch, quantity);
+		else if (mode == SHUFFLE)
+			shuffle(quantity, rng);
+		else
+			decimate(quantity);
+
+		// Mixing the spectra mixes the frames, and so the dry signal gets the same delay as the wet one
+		for (int k = 0; k < length; k += 4) {
+			simd::float_4 d = simd::float_4::load(dry + k);
+			(d + (simd::float_4::load(spectrum + k) - d) * dw).store(spectrum + k);
+		}
+		fft->irfft(spectrum, frame);
+
+		// Drop the hop that was just played and add the frame
+		std::memmove(ch.output, ch.output + hop, (length - hop) * sizeof(float));
+		std::memset(ch.output + length - hop, 0, hop * sizeof(float));
+		for (int k = 0; k < length; k += 4) {
+			simd::float_4 out = simd::float_4::load(ch.output + k) + simd::float_4::load(frame + k) * simd::float_4::load(synthesis + k);
+			out.store(ch.output + k);
+		}
+		std::memmove(ch.input, ch.input + hop, (length - hop) * sizeof(float));
+	}
+
+	/** Holds on to the spectrum, letting in `1 - quantity` of the new one every frame. All of it is held at 1.
+	The held spectrum gives the phases, with each bin turning by its frequency over a hop to keep playing, which is a
+	quarter turn per bin index. Bins between those frequencies don't turn quite right and cancel out over the frames,
+	so the magnitudes are held on their own.
+	*/
+	void freeze(Channel& ch, float quantity) {
+		computeMagnitudes();
+		for (int k = 0; k < length / 2; k += 4) {
+			simd::float_4 in = simd::float_4::load(magnitudes + k);
+			simd::float_4 held = simd::float_4::load(ch.frozenMagnitudes + k);
+			(in + (held - in) * quantity).store(ch.frozenMagnitudes + k);
+		}
+
+		// A float_4 holds two bins, and the turns repeat every 4 bins. The first bin pair is DC and Nyquist, which
+		// turn by whole turns.
+		const simd::float_4 turn01(1.f, 1.f, -1.f, 1.f); // Bins 4j and 4j + 1, times 1 and i
+		const simd::float_4 turn23(-1.f, -1.f, 1.f, -1.f); // Bins 4j + 2 and 4j + 3, times -1 and -i
+		for (int k = 0; k < length; k += 8) {
+			simd::float_4 held01 = simd::float_4::load(ch.frozen + k);
+			simd::float_4 held23 = simd::float_4::load(ch.frozen + k + 4);
+			held01 = simd::float_4(_mm_shuffle_ps(held01.v, held01.v, _MM_SHUFFLE(2, 3, 1, 0))) * turn01;
+			held23 = simd::float_4(_mm_shuffle_ps(held23.v, held23.v, _MM_SHUFFLE(2, 3, 1, 0))) * turn23;
+			simd::float_4 in01 = simd::float_4::load(spectrum + k);
+			simd::float_4 in23 = simd::float_4::load(spectrum + k + 4);
+			held01 = in01 + (held01 - in01) * quantity;
+			held23 = in23 + (held23 - in23) * quantity;
+			held01.store(ch.frozen + k);
+			held23.store(ch.frozen + k + 4);
+			held01.store(spectrum + k);
+			held23.store(spectrum + k + 4);
+		}
+		computeMagnitudes();
+		for (int k = 0; k < length / 2; k += 4) {
+			simd::float_4 held = simd::float_4::load(ch.frozenMagnitudes + k);
+			(held / (simd::float_4::load(magnitudes + k) + 1e-12f)).store(gains + k);
+		}
+		gains[0] = 1.f;
+		applyGains();
+	}
+
+	/** Swaps each bin with a chance of `quantity` with one of the bins above it, up to an eighth of the spectrum away
+	at full quantity. The swapped bins are skipped to with geometric waits.
+	*/
+	void shuffle(float quantity, Random& rng) {
+		int bins = length / 2;
+		int reach = std::max((int)(quantity * bins / 8), 1);
+		for (int k = 0;;) {
+			int skip = rng.geometric(quantity);
+			if (skip >= bins - k)
+				break;
+			k += skip;
+			int other = k + 1 + (int)(rng.uniform() * reach);
+			if (other >= bins)
+				continue;
+			std::swap(spectrum[2 * k], spectrum[2 * other]);
+			std::swap(spectrum[2 * k + 1], spectrum[2 * other + 1]);
+		}
+	}
+
+	/** Holds magnitudes across bins, the way Decimate holds samples: each run of up to 32 bins at full quantity takes
+	the magnitude of its first bin, keeping its own phases
+	*/
+	void decimate(float quantity) {
+		int bins = length / 2;
+		int run = 1 + (int)(quantity * 31.f);
+		if (run == 1)
+			return;
+		computeMagnitudes();
+		for (int k = 0; k < bins; k++)
+			gains[k] = magnitudes[k - k % run] / (magnitudes[k] + 1e-12f);
+		gains[0] = 1.f;
+		applyGains();
+	}
+
+	/** Magnitude of every bin of the spectrum, 4 at a time. The first pair is DC and Nyquist, of which only DC counts. */
+	void computeMagnitudes() {
+		for (int k = 0; k < length / 2; k += 4) {
+			__m128 a = _mm_load_ps(spectrum + 2 * k);
+			__m128 b = _mm_load_ps(spectrum + 2 * k + 4);
+			simd::float_4 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+			simd::float_4 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+			simd::sqrt(re * re + im * im).store(magnitudes + k);
+		}
+		magnitudes[0] = std::fabs(spectrum[0]);
+	}
+
+	/** Scales every bin of the spectrum by its gain, 4 at a time. The first gain scales DC and Nyquist. */
+	void applyGains() {
+		for (int k = 0; k < length / 2; k += 4) {
+			__m128 g = _mm_load_ps(gains + k);
+			simd::float_4 g01 = _mm_unpacklo_ps(g, g);
+			simd::float_4 g23 = _mm_unpackhi_ps(g, g);
+			(simd::float_4::load(spectrum + 2 * k) * g01).store(spectrum + 2 * k);
+			(simd::float_4::load(spectrum + 2 * k + 4) * g23).store(spectrum + 2 * k + 4);
+		}
+	}
+};
 
 struct Distroi : Module {
 	enum ParamId {
@@ -27,17 +350,66 @@ struct Distroi : Module {
 		LIGHTS_LEN
 	};
 
-	int decimateCounter = 0;
-  float heldSample = 0.0f;
+	// Per-channel effect state, in groups of 4 channels for SIMD
+	simd::float_4 decimateCounter[PORT_MAX_CHANNELS / 4] = {};
+	simd::float_4 heldSample[PORT_MAX_CHANNELS / 4] = {};
+
+	// The buffers of the Glitch row are only allocated while its input is connected, for the effect it runs, and
+	// never on the audio thread. requestBuffers() asks for their sizes, updateBuffers() builds them on the UI thread
+	// and takeBuffers() swaps them in.
+	float glitchSeconds = DEFAULT_GLITCH_SECONDS; // Length of the buffer, so of the longest grain, set from the context menu
+	BufferHandoff<GlitchBuffer> glitchBuffers;
+	int samplesMade[PORT_MAX_CHANNELS] = {}; // Recorded so far, up to the buffer length
+	int glitchWrite[PORT_MAX_CHANNELS] = {};
+
+	// Glitch plays grains from its buffer, from a pool of MAX_GLITCH_GRAINS per channel, 4 to a float_4. A grain reads
+	// from `grainPosition` onwards at `grainRate` while its phase goes from 0 to 1, through a parabolic window so it
+	// fades in and out. Free grains sit at phase 1 with a step of 0, where the window is 0.
+	int glitchGrains = DEFAULT_GLITCH_GRAINS; // Grains at full quantity, set from the context menu
+	simd::float_4 grainPosition[PORT_MAX_CHANNELS][MAX_GLITCH_GRAINS / 4];
+	simd::float_4 grainRate[PORT_MAX_CHANNELS][MAX_GLITCH_GRAINS / 4];
+	simd::float_4 grainPhase[PORT_MAX_CHANNELS][MAX_GLITCH_GRAINS / 4];
+	simd::float_4 grainStep[PORT_MAX_CHANNELS][MAX_GLITCH_GRAINS / 4];
 
-	float glitchBuffer[MAXGLITCHSAMPLES] = {};
-	int samplesMade = 0;
-	int glitchIndexWrite = 0;
-	int glitchIndexRead = 0;
-	int glitchTreshold = 0;
+	// Spectral, set from the context menu, takes over the Glitch row: its knobs, CV and jacks. process() picks up the
+	// settings at control rate, and its buffers follow them.
+	bool spectral = false;
+	int spectralMode = Spectral::FREEZE;
+	int spectralSize = DEFAULT_SPECTRAL_SIZE;
+	BufferHandoff<Spectral> spectralBuffers;
+	bool spectralActive = false; // `spectral` as process() last saw it
 
-	int cropRamp = 0;
-	int cropThreshold = 0;
+	simd::float_4 cropRamp[PORT_MAX_CHANNELS / 4] = {};
+	simd::float_4 cropThreshold[PORT_MAX_CHANNELS / 4] = {};
+
+	// Glitches and crops start at random, with the same chance on every sample they could start on. Instead of a draw
+	// on each of those samples, the wait until the next one is drawn when the last one starts and counted down.
+	// The events don't remember how long they've been waited for, so a new chance just draws a new wait.
+	int glitchWait[PORT_MAX_CHANNELS] = {}; // Samples until the next grain
+	simd::int32_4 cropWait[PORT_MAX_CHANNELS / 4] = {}; // Uncropped samples until the next crop
+	SeededRandom rng;
+
+	// Quantity and the coefficient derived from it, per effect and channel group. Polled at control rate.
+	// Bitcrush: bit scale, Decimate: hold length, Distort: drive gain, Glitch: quantity, Crop: chance per sample
+	ControlRate controlRate;
+	ProcessTimer timer;
+	simd::float_4 quantities[EFFECTSNR][PORT_MAX_CHANNELS / 4] = {};
+	simd::float_4 coefficients[EFFECTSNR][PORT_MAX_CHANNELS / 4] = {};
+	simd::float_4 bitcrushInvScale[PORT_MAX_CHANNELS / 4] = {};
+	int polledChannels[EFFECTSNR] = {};
+	SmoothedControl dryWet[EFFECTSNR];
+
+	// Bitcrush and Distort run at `oversampling` times the sample rate, set from the context menu
+	int oversampling = 1;
+	TOversampler<simd::float_4> bitcrushOversamplers[PORT_MAX_CHANNELS / 4];
+	TOversampler<simd::float_4> distortOversamplers[PORT_MAX_CHANNELS / 4];
+
+	// Chain mode, set from the context menu: the Bitcrush input goes through every effect in `chainOrder`, and each
+	// output carries the signal as it leaves its effect. Saves the cables, their latency and a pass over the channels
+	// per effect.
+	bool chain = false;
+	int chainOrder = DEFAULT_CHAIN_ORDER;
+	int order[EFFECTSNR] = {0, 1, 2, 3, 4}; // chainOrder unpacked, at control rate
 
 	ParamId PARAMS[EFFECTSNR] = {BITCHRUSH_PARAM, DECIMATE_PARAM, DISTORT_PARAM, GLITCH_PARAM, CROP_PARAM};
 
@@ -52,102 +424,483 @@ struct Distroi : Module {
 			configInput(CV_INPUT + i, NAMES[i] + " CV");
 			configOutput(OUTPUT + i, NAMES[i]);
 		}
+		for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
+			for (int j = 0; j < MAX_GLITCH_GRAINS / 4; j++) {
+				grainPosition[c][j] = 0.f;
+				grainRate[c][j] = 1.f;
+				grainPhase[c][j] = 1.f;
+				grainStep[c][j] = 0.f;
+			}
+		}
 	}
 
-	void process(const ProcessArgs& args) override {
+	void onAdd(const AddEvent& e) override {
+		resizeBuffers(APP->engine->getSampleRate());
+	}
 
-		for (int i = 0; i < EFFECTSNR; i++) {
-			if (!inputs[INPUT + i].isConnected() || !outputs[OUTPUT + i].isConnected()) continue;
+	void onSampleRateChange(const SampleRateChangeEvent& e) override {
+		controlRate.invalidate();
+		resizeBuffers(e.sampleRate);
+	}
 
-			float inputSignal = inputs[INPUT + i].getVoltage();
-			float cvAmmt = params[PARAMS[i] + 1].getValue();
-			float cv = inputs[CV_INPUT + i].isConnected() ? (inputs[CV_INPUT + i].getVoltage() / 10.f) * cvAmmt : 0.0f;
-			float quantity = clamp(params[PARAMS[i]].getValue() + cv, 0.f, 1.f);
+	void onPortChange(const PortChangeEvent& e) override {
+		if (e.type == Port::INPUT && (e.portId == INPUT || e.portId == INPUT + 3))
+			resizeBuffers(APP->engine->getSampleRate());
+	}
 
-			float dw = params[PARAMS[i] + 2].getValue();
-			float result = inputSignal;
+	/** Name of the effect in row `i`, which for the Glitch row depends on `spectral` */
+	std::string effectName(int i) {
+		return (i == 3 && spectral) ? SPECTRAL_NAME : NAMES[i];
+	}
 
-			if (i == 0) {
-				// Bitcrusher
-				float scale = pow(2.0f, 8 - ((0.2 + quantity) * 8));
-        result = round(inputSignal * scale) / scale;
+	/** Switches the Glitch row between Glitch and Spectral, renaming its controls and ports to match */
+	void setSpectral(bool spectral) {
+		this->spectral = spectral;
+		std::string name = effectName(3);
+		paramQuantities[GLITCH_PARAM]->name = name + " effect quantity";
+		paramQuantities[GLITCH_PARAM + 1]->name = name + " CV attenuator";
+		paramQuantities[GLITCH_PARAM + 2]->name = name + " dry/wet";
+		inputInfos[INPUT + 3]->name = name + " signal";
+		inputInfos[CV_INPUT + 3]->name = name + " CV";
+		outputInfos[OUTPUT + 3]->name = name;
+	}
+
+	/** The input of the Glitch row, which Glitch records or Spectral transforms: its own, or the chain's */
+	Input& glitchInput() {
+		return inputs[chain ? INPUT : INPUT + 3];
+	}
+
+	json_t* dataToJson() override {
+		json_t* rootJ = json_object();
+		json_object_set_new(rootJ, "glitchSeconds", json_real(glitchSeconds));
+		json_object_set_new(rootJ, "glitchGrains", json_integer(glitchGrains));
+		json_object_set_new(rootJ, "oversampling", json_integer(oversampling));
+		json_object_set_new(rootJ, "chain", json_boolean(chain));
+		json_t* chainOrderJ = json_array();
+		for (int k = 0; k < EFFECTSNR; k++)
+			json_array_append_new(chainOrderJ, json_integer(chainOrderEffect(chainOrder, k)));
+		json_object_set_new(rootJ, "chainOrder", chainOrderJ);
+		json_object_set_new(rootJ, "spectral", json_boolean(spectral));
+		json_object_set_new(rootJ, "spectralMode", json_integer(spectralMode));
+		json_object_set_new(rootJ, "spectralSize", json_integer(spectralSize));
+		rng.dataToJson(rootJ);
+		return rootJ;
+	}
+
+	void dataFromJson(json_t* rootJ) override {
+		json_t* glitchSecondsJ = json_object_get(rootJ, "glitchSeconds");
+		if (glitchSecondsJ)
+			glitchSeconds = clamp((float) json_number_value(glitchSecondsJ), GLITCH_SECONDS.front(), GLITCH_SECONDS.back());
+		json_t* glitchGrainsJ = json_object_get(rootJ, "glitchGrains");
+		if (glitchGrainsJ)
+			glitchGrains = clamp((int) json_integer_value(glitchGrainsJ), 1, MAX_GLITCH_GRAINS);
+		json_t* oversamplingJ = json_object_get(rootJ, "oversampling");
+		if (oversamplingJ)
+			oversampling = clamp((int) json_integer_value(oversamplingJ), 1, TOversampler<>::MAX_FACTOR);
+		json_t* chainJ = json_object_get(rootJ, "chain");
+		if (chainJ)
+			chain = json_boolean_value(chainJ);
+		json_t* chainOrderJ = json_object_get(rootJ, "chainOrder");
+		if (chainOrderJ) {
+			// Anything but an order of all five effects is ignored
+			int loaded = 0;
+			int seen = 0;
+			for (int k = 0; k < EFFECTSNR; k++) {
+				int effect = json_integer_value(json_array_get(chainOrderJ, k));
+				if (effect < 0 || effect >= EFFECTSNR)
+					break;
+				loaded = setChainOrderEffect(loaded, k, effect);
+				seen |= 1 << effect;
 			}
+			if (seen == (1 << EFFECTSNR) - 1)
+				chainOrder = loaded;
+		}
+		json_t* spectralJ = json_object_get(rootJ, "spectral");
+		if (spectralJ)
+			setSpectral(json_boolean_value(spectralJ));
+		json_t* spectralModeJ = json_object_get(rootJ, "spectralMode");
+		if (spectralModeJ)
+			spectralMode = clamp((int) json_integer_value(spectralModeJ), 0, (int) SPECTRAL_MODES.size() - 1);
+		json_t* spectralSizeJ = json_object_get(rootJ, "spectralSize");
+		if (spectralSizeJ) {
+			// Only one of the sizes in the menu
+			int size = json_integer_value(spectralSizeJ);
+			if (std::find(SPECTRAL_SIZES.begin(), SPECTRAL_SIZES.end(), size) != SPECTRAL_SIZES.end())
+				spectralSize = size;
+		}
+		rng.dataFromJson(rootJ);
+		resizeBuffers(APP->engine->getSampleRate());
+	}
 
-			if (i == 1) {
-				// Decimator
-				decimateCounter++;
-        if (decimateCounter >= quantity * 32) {
-					heldSample = inputSignal; // Update the held sample
-					decimateCounter = 0;
-        }
-				result = heldSample;
+	/** Asks for the buffers of the effect on the Glitch row at `sampleRate`, and none for the other one. Called by
+	process() and the events.
+	*/
+	void requestBuffers(float sampleRate) {
+		int channels = glitchInput().isConnected() ? std::max(glitchInput().getChannels(), 1) : 0;
+		int glitchChannels = spectral ? 0 : channels;
+		glitchBuffers.request(glitchChannels, glitchChannels ? std::max((int)(glitchSeconds * sampleRate), 1) : 0);
+		int spectralChannels = spectral ? channels : 0;
+		spectralBuffers.request(spectralChannels, spectralChannels ? spectralSize : 0);
+	}
+
+	/** Builds the requested buffers and frees retired ones. Called by the module widget on the UI thread. */
+	void updateBuffers(bool wait = false) {
+		glitchBuffers.update(wait);
+		spectralBuffers.update(wait);
+	}
+
+	/** Swaps in the buffers built by updateBuffers(). Called by process(). */
+	void takeBuffers() {
+		if (glitchBuffers.take()) {
+			for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
+				samplesMade[c] = 0;
+				glitchWrite[c] = 0;
+				for (int j = 0; j < MAX_GLITCH_GRAINS / 4; j++) {
+					grainPhase[c][j] = 1.f;
+					grainStep[c][j] = 0.f;
+				}
 			}
+		}
+		// Spectral buffers start over from silence
+		spectralBuffers.take();
+	}
+
+	/** Resizes the buffers right away. Only for events, during which the engine doesn't call process(). */
+	void resizeBuffers(float sampleRate) {
+		requestBuffers(sampleRate);
+		updateBuffers(true);
+		takeBuffers();
+		updateBuffers(true);
+	}
 
+	/** Polls quantity knob and CV of effect `i` and recomputes the coefficients of channel groups whose quantity changed. */
+	void pollEffect(int i, int channels, bool force) {
+		float cvAmmt = params[PARAMS[i] + 1].getValue();
+		bool cvConnected = inputs[CV_INPUT + i].isConnected();
+		float knob = params[PARAMS[i]].getValue();
+
+		for (int c = 0; c < channels; c += 4) {
+			int g = c / 4;
+			simd::float_4 cv = cvConnected ? (inputs[CV_INPUT + i].getPolyVoltageSimd<simd::float_4>(c) / 10.f) * cvAmmt : 0.f;
+			simd::float_4 quantity = simd::clamp(knob + cv, 0.f, 1.f);
+			if (controlEquals(quantity, quantities[i][g]) && !force)
+				continue;
+			quantities[i][g] = quantity;
+
+			if (i == 0) {
+				simd::float_4 scale = fastmath::exp2(8.f - ((0.2f + quantity) * 8.f));
+				coefficients[i][g] = scale;
+				bitcrushInvScale[g] = 1.f / scale;
+			}
+			if (i == 1) {
+				coefficients[i][g] = quantity * 32.f;
+			}
 			if (i == 2) {
-				// Distort
-				float drive = quantity * 10.f;
-				result = tanh(inputSignal * (1 + drive));
+				coefficients[i][g] = 1.f + quantity * 10.f;
 			}
-
 			if (i == 3) {
-				// Glitch
-				// Grab a random sample from the signal and occasionally rewrite it or play it
-				// Constantly write little fragments of signal in the same buffer, grain like / regular buffering and jumped buffering
-				// Wait until buffer is full before glitching
-				// Once is glitched, randomly start glitch read
-				if (samplesMade < MAXGLITCHSAMPLES) {
-					glitchBuffer[samplesMade] = inputSignal;
-					samplesMade++;
-					result = inputSignal;
-				} else {
-					if (glitchIndexRead < glitchTreshold) {
-						// Currently glitching
-						result = glitchBuffer[glitchIndexRead];
-						glitchBuffer[glitchIndexRead] = inputSignal;
-						glitchIndexRead++;
-					} else {
-						if (random::uniform() < quantity) {
-							glitchTreshold = (int)(random::uniform() * (MAXGLITCHSAMPLES - (quantity * 0.9 * MAXGLITCHSAMPLES)));
-							glitchIndexRead = 0;
-						}
-						result = inputSignal;
-					}
-				}
+				coefficients[i][g] = quantity;
+				for (int l = 0; l < 4 && c + l < channels; l++)
+					glitchWait[c + l] = rng.geometric(quantity[l] * GLITCH_CHANCE);
+			}
+			if (i == 4) {
+				coefficients[i][g] = quantity * 0.001f;
+				// Lanes past the last channel never start cropping
+				for (int l = 0; l < 4; l++)
+					cropWait[g][l] = (c + l < channels) ? rng.geometric(coefficients[i][g][l]) : INT32_MAX;
+			}
+		}
+		polledChannels[i] = channels;
+	}
+
+	simd::float_4 bitcrush(simd::float_4 inputSignal, int g) {
+		return simd::round(inputSignal * coefficients[0][g]) * bitcrushInvScale[g];
+	}
+
+	simd::float_4 decimate(simd::float_4 inputSignal, int g) {
+		decimateCounter[g] += 1.f;
+		simd::float_4 hold = decimateCounter[g] >= coefficients[1][g];
+		heldSample[g] = simd::ifelse(hold, inputSignal, heldSample[g]); // Update the held sample
+		decimateCounter[g] = simd::ifelse(hold, 0.f, decimateCounter[g]);
+		return heldSample[g];
+	}
+
+	simd::float_4 distort(simd::float_4 inputSignal, int g) {
+		return fastmath::tanh(inputSignal * coefficients[2][g]);
+	}
+
+	/** Records a sample of channel `c` and mixes the grains playing over it */
+	float glitch(float inputSignal, float quantity, int c) {
+		GlitchBuffer* glitchBuffer = glitchBuffers.buffer;
+		if (!glitchBuffer || c >= glitchBuffer->channels)
+			return inputSignal; // Until its buffer arrives
+		int length = glitchBuffer->length;
+		float* buffer = glitchBuffer->region(c);
+		buffer[glitchWrite[c]] = inputSignal;
+		if (++glitchWrite[c] == length)
+			glitchWrite[c] = 0;
+		samplesMade[c] = std::min(samplesMade[c] + 1, length);
+
+		if (--glitchWait[c] <= 0) {
+			// A wait of INT32_MAX runs out without a grain when the quantity is 0
+			if (quantity > 0.f)
+				startGrain(c, quantity);
+			glitchWait[c] = rng.geometric(quantity * GLITCH_CHANCE);
+		}
 
+		// Grains pile up in `mix`, and their windows in `cover`, where the dry signal fills the rest
+		simd::float_4 mix = 0.f;
+		simd::float_4 cover = 0.f;
+		for (int j = 0; j < MAX_GLITCH_GRAINS / 4; j++) {
+			simd::float_4 phase = grainPhase[c][j];
+			if (!simd::movemask(phase < 1.f))
+				continue;
+			simd::float_4 position = grainPosition[c][j];
+			simd::float_4 index = simd::floor(position);
+			simd::float_4 frac = position - index;
+			simd::float_4 a, b;
+			for (int l = 0; l < 4; l++) {
+				int i = (int) index[l];
+				a[l] = buffer[i];
+				b[l] = buffer[(i + 1 == length) ? 0 : i + 1];
 			}
+			simd::float_4 window = 4.f * phase * (1.f - phase);
+			mix += (a + (b - a) * frac) * window;
+			cover += window;
 
-			if (i == 4) {
-				// Crop
-				// Occasionally silence signal abruptly
-				if (cropRamp < cropThreshold) {
-					// Currently cropping
-					result = inputSignal * 0.01f;
-					cropRamp++;
-				} else {
-					if (random::uniform() < quantity * 0.001) {
-						cropThreshold = (int)(random::uniform() * args.sampleRate * 0.1);
-						cropRamp = 0;
-					}
-					result = inputSignal;
+			position += grainRate[c][j];
+			// Rounding can take a position just below 0 up to `length`, which the second wrap catches
+			position = simd::ifelse(position < 0.f, position + length, position);
+			position = simd::ifelse(position >= length, position - length, position);
+			grainPosition[c][j] = position;
+			grainPhase[c][j] = simd::fmin(phase + grainStep[c][j], 1.f);
+		}
+		float grains = mix[0] + mix[1] + mix[2] + mix[3];
+		float covered = cover[0] + cover[1] + cover[2] + cover[3];
+		// Overlapping grains share the output instead of adding up
+		if (covered > 1.f)
+			return grains / covered;
+		return grains + inputSignal * (1.f - covered);
+	}
+
+	/** Starts a grain on channel `c` if one of the first grains `quantity` allows is free. Grains get shorter and
+	more of them may overlap as the quantity goes up.
+	*/
+	void startGrain(int c, float quantity) {
+		int allowed = std::max((int) std::ceil(quantity * glitchGrains), 1);
+		int grain = -1;
+		for (int k = 0; k < allowed && grain < 0; k++) {
+			if (grainPhase[c][k / 4][k % 4] >= 1.f)
+				grain = k;
+		}
+		int span = samplesMade[c];
+		if (grain < 0 || span < 64)
+			return;
+		int length = glitchBuffers.buffer->length;
+
+		float rate = GLITCH_RATES[std::min((int)(rng.uniform() * LENGTHOF(GLITCH_RATES)), (int) LENGTHOF(GLITCH_RATES) - 1)];
+		float samples = std::max(rng.uniform() * (1.f - quantity * 0.9f) * length, 32.f);
+		// The grain has to stay within the recorded span while the write head moves on, which it drifts against by
+		// `drift` samples per sample. Faster grains start further back to not catch up with it. Staying 2 samples
+		// behind keeps the interpolation off the sample about to be written.
+		float drift = std::fabs(rate - 1.f);
+		if (drift > 0.f)
+			samples = std::min(samples, (span - 3) / drift);
+		float room = span - 3 - drift * samples;
+		float behind = 2.f + rng.uniform() * room + (rate > 1.f ? drift * samples : 0.f);
+		float position = glitchWrite[c] - behind;
+		if (position < 0.f)
+			position += length;
+
+		int j = grain / 4;
+		int l = grain % 4;
+		grainPosition[c][j][l] = position;
+		grainRate[c][j][l] = rate;
+		grainPhase[c][j][l] = 0.f;
+		grainStep[c][j][l] = 1.f / samples;
+	}
+
+	simd::float_4 crop(simd::float_4 inputSignal, int g, float sampleRate) {
+		// Occasionally silence signal abruptly
+		simd::float_4 cropping = cropRamp[g] < cropThreshold[g];
+		cropRamp[g] += simd::ifelse(cropping, 1.f, 0.f);
+
+		// Counts down the lanes that aren't cropping, where the mask is -1
+		simd::int32_4 idle = simd::int32_4::cast(~cropping);
+		cropWait[g] += idle;
+		simd::int32_4 start = idle & (cropWait[g] < 1);
+		if (simd::movemask(start)) {
+			for (int l = 0; l < 4; l++) {
+				if (!start[l])
+					continue;
+				float chance = coefficients[4][g][l];
+				if (chance > 0.f) {
+					cropThreshold[g][l] = (int)(rng.uniform() * sampleRate * 0.1f);
+					cropRamp[g][l] = 0.f;
 				}
+				cropWait[g][l] = rng.geometric(chance);
 			}
+		}
+		return simd::ifelse(cropping, inputSignal * 0.01f, inputSignal);
+	}
 
-			float output = (inputSignal * (1 - dw)) + (result * dw); 
+	/** Runs effect `i` on channels c to c + 3, mixed with its input by `dw` */
+	simd::float_4 processEffect(int i, simd::float_4 inputSignal, int c, int channels, float dw, float sampleRate) {
+		int g = c / 4;
+		simd::float_4 result = inputSignal;
+
+		if (i == 0) {
+			// Bitcrusher, oversampled along with its dry signal so both stay aligned
+			return bitcrushOversamplers[g].process(inputSignal, [&](simd::float_4 x) {
+				return (x * (1 - dw)) + (bitcrush(x, g) * dw);
+			});
+		}
+
+		if (i == 1) {
+			// Decimator
+			result = decimate(inputSignal, g);
+		}
+
+		if (i == 2) {
+			// Distort, oversampled like the bitcrusher
+			return distortOversamplers[g].process(inputSignal, [&](simd::float_4 x) {
+				return (x * (1 - dw)) + (distort(x, g) * dw);
+			});
+		}
+
+		if (i == 3 && spectralActive) {
+			// Spectral, which mixes its dry signal itself. The input passes through until its buffers arrive.
+			Spectral* buffer = spectralBuffers.buffer;
+			for (int l = 0; l < 4 && c + l < channels; l++) {
+				if (buffer && c + l < buffer->channels)
+					result[l] = buffer->process(inputSignal[l], c + l, coefficients[3][g][l], dw, spectralMode, rng);
+			}
+			return result;
+		}
+
+		if (i == 3) {
+			// Glitch
+			for (int l = 0; l < 4 && c + l < channels; l++)
+				result[l] = glitch(inputSignal[l], coefficients[3][g][l], c + l);
+		}
 
-			outputs[OUTPUT + i].setVoltage(output);
+		if (i == 4) {
+			// Crop
+			result = crop(inputSignal, g, sampleRate);
+		}
+
+		return (inputSignal * (1 - dw)) + (result * dw);
+	}
+
+	/** Polls effect `i` for `channels` channels when it's due and returns its dry/wet for this sample */
+	float pollDryWet(int i, int channels, bool poll) {
+		// Newly patched channels can't wait for the next poll
+		if (poll || channels > polledChannels[i]) {
+			pollEffect(i, channels, controlRate.forced || channels > polledChannels[i]);
+			dryWet[i].setTarget(params[PARAMS[i] + 2].getValue(), controlRate.getDivision());
+		}
+		return dryWet[i].process();
+	}
+
+	/** Every effect on its own input and output */
+	void processEffects(const ProcessArgs& args, bool poll) {
+		for (int i = 0; i < EFFECTSNR; i++) {
+			if (!inputs[INPUT + i].isConnected() || !outputs[OUTPUT + i].isConnected()) continue;
+
+			int channels = inputs[INPUT + i].getChannels();
+			outputs[OUTPUT + i].setChannels(channels);
+			float dw = pollDryWet(i, channels, poll);
+
+			for (int c = 0; c < channels; c += 4) {
+				simd::float_4 inputSignal = inputs[INPUT + i].getVoltageSimd<simd::float_4>(c);
+				outputs[OUTPUT + i].setVoltageSimd(processEffect(i, inputSignal, c, channels, dw, args.sampleRate), c);
+			}
+		}
+	}
+
+	/** The Bitcrush input through every effect in `order`, a channel group at a time */
+	void processChain(const ProcessArgs& args, bool poll) {
+		if (!inputs[INPUT].isConnected())
+			return;
+		int channels = inputs[INPUT].getChannels();
+		float dw[EFFECTSNR];
+		bool tapped[EFFECTSNR];
+		for (int i = 0; i < EFFECTSNR; i++) {
+			dw[i] = pollDryWet(i, channels, poll);
+			tapped[i] = outputs[OUTPUT + i].isConnected();
+			if (tapped[i])
+				outputs[OUTPUT + i].setChannels(channels);
+		}
+
+		// Bitcrush and Distort next to each other share one trip to the oversampled rate, unless the first one's output
+		// is patched and needs the signal between them
+		int fused = -1;
+		for (int k = 0; k + 1 < EFFECTSNR; k++) {
+			int i = order[k];
+			int next = order[k + 1];
+			if (oversampling > 1 && (i == 0 || i == 2) && next == 2 - i && !tapped[i])
+				fused = k;
+		}
+
+		for (int c = 0; c < channels; c += 4) {
+			int g = c / 4;
+			simd::float_4 signal = inputs[INPUT].getVoltageSimd<simd::float_4>(c);
+			for (int k = 0; k < EFFECTSNR; k++) {
+				int i = order[k];
+				if (k == fused) {
+					int next = order[k + 1];
+					signal = bitcrushOversamplers[g].process(signal, [&](simd::float_4 x) {
+						x = (x * (1 - dw[i])) + ((i == 0 ? bitcrush(x, g) : distort(x, g)) * dw[i]);
+						return (x * (1 - dw[next])) + ((next == 0 ? bitcrush(x, g) : distort(x, g)) * dw[next]);
+					});
+					i = next;
+					k++;
+				}
+				else {
+					signal = processEffect(i, signal, c, channels, dw[i], args.sampleRate);
+				}
+				if (tapped[i])
+					outputs[OUTPUT + i].setVoltageSimd(signal, c);
+			}
 		}
 	}
+
+	void process(const ProcessArgs& args) override {
+		ProcessTimer::Scope timing(timer);
+		bool poll = controlRate.process();
+		if (poll) {
+			requestBuffers(args.sampleRate);
+			takeBuffers();
+			for (int g = 0; g < PORT_MAX_CHANNELS / 4; g++) {
+				bitcrushOversamplers[g].setFactor(oversampling);
+				distortOversamplers[g].setFactor(oversampling);
+			}
+			for (int k = 0; k < EFFECTSNR; k++)
+				order[k] = chainOrderEffect(chainOrder, k);
+			spectralActive = spectral;
+		}
+
+		if (chain)
+			processChain(args, poll);
+		else
+			processEffects(args, poll);
+	}
 };
 
 
 struct DistroiWidget : ModuleWidget {
+	TextDisplayWidget* glitchLabel = NULL; // Reads Spectral while that has the row
+
 	DistroiWidget(Distroi* module) {
 		setModule(module);
 		setPanel(createPanel(asset::plugin(pluginInstance, "res/Distroi.svg")));
 
+		LabelLayer* labels = new LabelLayer(box.size);
+		addChild(labels);
+
 		float hp = 5.08f;
 
-		addChild(new TextDisplayWidget("Distroi", Vec(hp/2, hp*1.5), 14, -1));
+		labels->addLabel("Distroi", Vec(hp/2, hp*1.5), 14, -1);
 		addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, 0)));
 		addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
 
@@ -162,7 +915,9 @@ struct DistroiWidget : ModuleWidget {
 		Distroi::ParamId PARAMS[EFFECTSNR] = {Distroi::BITCHRUSH_PARAM, Distroi::DECIMATE_PARAM, Distroi::DISTORT_PARAM, Distroi::GLITCH_PARAM, Distroi::CROP_PARAM};
 
 		for (int i = 0; i < EFFECTSNR; i++) {
-			addChild(new TextDisplayWidget(NAMES[i], Vec(minX3 + (divX3 * 1.f), controlsY + (divYcontrols * i) - tOffset), 10));
+			TextDisplayWidget* label = labels->addLabel(NAMES[i], Vec(minX3 + (divX3 * 1.f), controlsY + (divYcontrols * i) - tOffset), 10);
+			if (i == 3)
+				glitchLabel = label;
 			addParam(createParamCentered<RoundSmallBlackKnob>(mm2px(Vec(minX3, controlsY + (divYcontrols * i))), module, PARAMS[i]));
 			addParam(createParamCentered<RoundSmallBlackKnob>(mm2px(Vec(minX3 + divX3, controlsY + (divYcontrols * i))), module, PARAMS[i] + 1));
 			addParam(createParamCentered<RoundSmallBlackKnob>(mm2px(Vec(minX3 + (divX3 * 2.f), controlsY + (divYcontrols * i))), module, PARAMS[i] + 2));
@@ -171,6 +926,94 @@ struct DistroiWidget : ModuleWidget {
 			addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(minX3 + (divX3 * 2), controlsY + (divYcontrols * (i + 0.4f)))), module, Distroi::OUTPUT + i));
 		}
 	}
+
+	void step() override {
+		Distroi* module = getModule<Distroi>();
+		if (module) {
+			module->updateBuffers();
+			glitchLabel->setText(module->effectName(3));
+		}
+		ModuleWidget::step();
+	}
+
+	void appendContextMenu(Menu* menu) override {
+		Distroi* module = getModule<Distroi>();
+
+		std::vector<std::string> labels;
+		for (float seconds : GLITCH_SECONDS)
+			labels.push_back(string::f("%g s", seconds));
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createIndexSubmenuItem("Maximum glitch length", labels,
+			[=]() {
+				for (size_t i = 0; i < GLITCH_SECONDS.size(); i++) {
+					if (module->glitchSeconds <= GLITCH_SECONDS[i])
+						return i;
+				}
+				return GLITCH_SECONDS.size() - 1;
+			},
+			[=](size_t i) {
+				module->glitchSeconds = GLITCH_SECONDS[i];
+			}
+		));
+		std::vector<std::string> grainLabels;
+		for (int grains : GLITCH_GRAINS)
+			grainLabels.push_back(std::to_string(grains));
+		menu->addChild(createIndexSubmenuItem("Glitch grains at full quantity", grainLabels,
+			[=]() {
+				auto it = std::lower_bound(GLITCH_GRAINS.begin(), GLITCH_GRAINS.end(), module->glitchGrains);
+				return (size_t) std::min<long>(it - GLITCH_GRAINS.begin(), GLITCH_GRAINS.size() - 1);
+			},
+			[=](size_t i) {module->glitchGrains = GLITCH_GRAINS[i];}
+		));
+
+		std::vector<std::string> sizeLabels;
+		for (int size : SPECTRAL_SIZES)
+			sizeLabels.push_back(string::f("%d (%.0f ms latency)", size, 1000.f * size / APP->engine->getSampleRate()));
+		menu->addChild(createBoolMenuItem("Spectral instead of Glitch", "",
+			[=]() {return module->spectral;},
+			[=](bool spectral) {module->setSpectral(spectral);}
+		));
+		menu->addChild(createIndexPtrSubmenuItem("Spectral effect", SPECTRAL_MODES, &module->spectralMode));
+		menu->addChild(createIndexSubmenuItem("Spectral FFT size", sizeLabels,
+			[=]() {
+				auto it = std::find(SPECTRAL_SIZES.begin(), SPECTRAL_SIZES.end(), module->spectralSize);
+				return (size_t)(it - SPECTRAL_SIZES.begin());
+			},
+			[=](size_t i) {module->spectralSize = SPECTRAL_SIZES[i];}
+		));
+		menu->addChild(createIndexSubmenuItem("Bitcrush and distort oversampling", OVERSAMPLING_LABELS,
+			[=]() {return oversamplingIndex(module->oversampling);},
+			[=](size_t i) {module->oversampling = 1 << i;}
+		));
+
+		std::vector<std::string> effectLabels;
+		for (int i = 0; i < EFFECTSNR; i++)
+			effectLabels.push_back(module->effectName(i));
+		menu->addChild(createBoolPtrMenuItem("Chain effects", "", &module->chain));
+		menu->addChild(createSubmenuItem("Chain order", "",
+			[=](Menu* menu) {
+				for (int k = 0; k < EFFECTSNR; k++) {
+					menu->addChild(createIndexSubmenuItem(std::to_string(k + 1), effectLabels,
+						[=]() {return (size_t) chainOrderEffect(module->chainOrder, k);},
+						[=](size_t effect) {
+							// Swaps places with the effect's old position, so every effect stays in the chain once
+							int order = module->chainOrder;
+							for (int other = 0; other < EFFECTSNR; other++) {
+								if (chainOrderEffect(order, other) == (int) effect)
+									order = setChainOrderEffect(order, other, chainOrderEffect(order, k));
+							}
+							module->chainOrder = setChainOrderEffect(order, k, effect);
+						}
+					));
+				}
+				menu->addChild(new MenuSeparator);
+				menu->addChild(createMenuItem("Reset order", "", [=]() {module->chainOrder = DEFAULT_CHAIN_ORDER;}));
+			}
+		));
+		module->rng.appendContextMenu(menu);
+		module->timer.appendContextMenu(menu, module);
+	}
 };
 
 
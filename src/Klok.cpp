@@ -24,6 +24,7 @@ struct Klok : Module {
 	enum OutputId {
 		RESET_OUTPUT,
 		ENUMS(MOD_OUTPUT, MOD_OUTPUTS),
+		POLY_OUTPUT,
 		OUTPUTS_LEN
 	};
 	enum LightId {
@@ -33,13 +34,24 @@ struct Klok : Module {
 
 	dsp::PulseGenerator pgen;
 	dsp::PulseGenerator preset;
-
-	float counter, period;
+	ControlRate controlRate;
+	ProcessTimer timer;
+	LightRate lightRate;
+	LightPeak blink;
+
+	float BPM = 0.f;
+	float running = 0.f;
+	float counter = 0.f, period = 0.f;
 	float TRIG_TIME = 1e-3f;
 	int steps = 0;
 	bool reset = true;
 	int output_offset = MOD_OUTPUT;
 
+	// Frame of the next clock tick, published to the neighbours
+	TransportLink link;
+	int64_t nextTick = -1;
+	int64_t resetFrame = -1;
+
 	Klok() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
 		configParam(RUN_PARAM, 0.f, 1.f, 0.f, "Run clock");
@@ -48,11 +60,43 @@ struct Klok : Module {
 		for (int i = 0; i < MOD_OUTPUTS; i++) {
 			configOutput(MOD_OUTPUT + i, "Modulo " + std::to_string(i));
 		}
+		configOutput(POLY_OUTPUT, "Polyphonic modulo");
+		link.setup(this);
+	}
+
+	/** Works out the frame of the next tick from the current frame, before the counter is checked */
+	void scheduleTick(int64_t frame) {
+		nextTick = frame + std::max(0, (int) std::floor(period - counter) + 1);
+	}
+
+	void publish(const ProcessArgs& args) {
+		TransportMessage message;
+		message.clocked = true;
+		message.running = running;
+		message.nextTick = nextTick;
+		message.resetFrame = resetFrame;
+		link.source = -1;
+		link.forward(this, message, args.frame);
+	}
+
+	void onSampleRateChange(const SampleRateChangeEvent& e) override {
+		controlRate.invalidate();
 	}
 
 	void process(const ProcessArgs& args) override {
-		float BPM = params[TEMPO_PARAM].getValue();
-		float running = params[RUN_PARAM].getValue();
+		ProcessTimer::Scope timing(timer);
+		if (controlRate.process()) {
+			running = params[RUN_PARAM].getValue();
+			float bpm = params[TEMPO_PARAM].getValue();
+			if (bpm != BPM || controlRate.forced) {
+				BPM = bpm;
+				period = 60.f * args.sampleRate/(BPM * 2); // Samples that need to pass before a new trigger, get octave notes
+				scheduleTick(args.frame);
+			}
+		}
+
+		// The poly output carries every modulo output, a channel each
+		outputs[POLY_OUTPUT].setChannels(MOD_OUTPUTS);
 
 		if (running) {
 			
@@ -61,34 +105,51 @@ struct Klok : Module {
 				// Send reset pulse
 				preset.trigger(TRIG_TIME);
 				reset = false;
+				resetFrame = args.frame;
+				scheduleTick(args.frame);
 			}
 			float resetout = preset.process(args.sampleTime);
 			outputs[RESET_OUTPUT].setVoltage(10.f * resetout);
 
 			// CLOCK PULSE
-			period = 60.f * args.sampleRate/(BPM * 2); // Samples that need to pass before a new trigger, get octave notes
-
-			if (counter > period) {
+			// Ticks on the announced frame, which is when the counter goes over the period
+			bool tick = args.frame >= nextTick;
+			if (tick) {
 				pgen.trigger(TRIG_TIME);
 				counter -= period; // Compensate for small errors
 				steps++;
 				steps %= MOD_OUTPUTS;
 			}
 			counter++;
+			if (tick)
+				scheduleTick(args.frame + 1);
 
 			float out = pgen.process(args.sampleTime); // Gets the state of the trigger
-			for (int i = output_offset; i < OUTPUTS_LEN; i++) {
+			Output& poly = outputs[POLY_OUTPUT];
+			bool polyConnected = poly.isConnected();
+			for (int i = output_offset; i < MOD_OUTPUT + MOD_OUTPUTS; i++) {
 				// Loop through all modulo outputs
-				if (steps % i - output_offset + 1 == 0 && outputs[i].isConnected()) {
-					outputs[i].setVoltage(10.f * out); // Set the value using the general pulse generator
+				if (steps % i - output_offset + 1 == 0) {
+					// Set the value using the general pulse generator
+					if (outputs[i].isConnected())
+						outputs[i].setVoltage(10.f * out);
+					if (polyConnected)
+						poly.setVoltage(10.f * out, i - MOD_OUTPUT);
 				}
 			}
-			lights[BLINK_LIGHT].setSmoothBrightness(out, 5e-6f); // Set light to value between 0 and 1, second argument sets vinishing time
+			blink.hold(out);
 
 		} else {
-			counter = period = steps = 0;
+			counter = steps = 0;
 			reset = true;
 		}
+
+		if (lightRate.process()) {
+			// Lights up on each tick and fades out over a fraction of a second
+			lights[BLINK_LIGHT].setBrightnessSmooth(blink.take(), lightRate.getDeltaTime(args.sampleTime), 7.f);
+		}
+
+		publish(args);
 	}
 };
 
@@ -98,35 +159,48 @@ struct KlokWidget : ModuleWidget {
 		setModule(module);
 		setPanel(createPanel(asset::plugin(pluginInstance, "res/Klok.svg")));
 
+		LabelLayer* labels = new LabelLayer(box.size);
+		addChild(labels);
+
 		float hp = 5.08f;
 
-		addChild(new TextDisplayWidget("Klok", Vec(hp/2, hp*1.5), 14, -1));
+		labels->addLabel("Klok", Vec(hp/2, hp*1.5), 14, -1);
 		addChild(createLightCentered<SmallLight<BlueLight>>(mm2px(Vec(hp/2 + 5.75f, hp*1.5)), module, Klok::BLINK_LIGHT));
 		addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, 0)));
 		addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
 
 		float runY = 22.f;
 
-		addChild(new TextDisplayWidget("Run", Vec(hp, runY - 6.f), 10));
+		labels->addLabel("Run", Vec(hp, runY - 6.f), 10);
 		addParam(createParamCentered<CKSS>(mm2px(Vec(hp, runY)), module, Klok::RUN_PARAM));
-		addChild(new TextDisplayWidget("Rst", Vec(hp * 2.7f, runY - 6.f), 10));
+		labels->addLabel("Rst", Vec(hp * 2.7f, runY - 6.f), 10);
 		addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(hp * 2.7f, runY)), module, Klok::RESET_OUTPUT));
 
 		float tempoY = 38.f;
 
-		addChild(new TextDisplayWidget("Tempo", Vec(hp*2, tempoY - 7.f), 10));
+		labels->addLabel("Tempo", Vec(hp*2, tempoY - 7.f), 10);
 		addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(hp*2, tempoY)), module, Klok::TEMPO_PARAM));
 
 		float minX = hp*2.6f;
-		float outY = 56.f;
-		float divY = 9.f;
+		float outY = 55.f;
+		float divY = 8.f;
 
-		addChild(new TextDisplayWidget("%", Vec(hp*2, outY - 7.f), 16));
+		labels->addLabel("%", Vec(hp*2, outY - 7.f), 16);
 
 		for (int i = 0; i < MOD_OUTPUTS; i++) {
-			addChild(new TextDisplayWidget(Convert(i), Vec(hp, outY + (divY * i)), 16));
+			labels->addLabel(Convert(i), Vec(hp, outY + (divY * i)), 16);
 			addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(minX, outY + (divY * i))), module, Klok::MOD_OUTPUT + i));
 		}
+		float polyY = outY + divY * MOD_OUTPUTS;
+		labels->addLabel("Poly", Vec(hp, polyY), 10);
+		addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(minX, polyY)), module, Klok::POLY_OUTPUT));
+	}
+
+	void appendContextMenu(Menu* menu) override {
+		Klok* module = getModule<Klok>();
+
+		menu->addChild(new MenuSeparator);
+		module->timer.appendContextMenu(menu, module);
 	}
 };
 
@@ -1,10 +1,73 @@
 #include "plugin.hpp"
+#include <algorithm>
+#include <atomic>
 
 const int SIGNALS = 30;
 const int COLUMNS = 5;
 const int ROWS = 6;
 const int MAX_STEPS = 16;
 const int ALERTS = 2;
+const int MAX_SCENES = 64;
+
+// Lengths an arranged scene can have instead of its row's steps knob
+static const std::vector<int> ARRANGED_STEPS = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 24, 32, 48, 64};
+
+/** An arranged scene: the row of inputs it plays, for `steps` steps or, if 0, the steps knob of that row */
+struct ArrangedScene {
+	int row = 0;
+	int steps = 0;
+};
+
+/** The scenes Scener plays, in order, with the step each one starts on. Finding the scene of a step is a binary
+search over the starts, and the table is only rebuilt when a steps knob or the arrangement changes.
+*/
+struct SceneTable {
+	int count = 0;
+	int rows[MAX_SCENES] = {};
+	int steps[MAX_SCENES] = {};
+	int starts[MAX_SCENES] = {}; // Steps of the scenes before
+	int total = 0;
+
+	void clear() {
+		count = 0;
+		total = 0;
+	}
+
+	void add(int row, int n) {
+		rows[count] = row;
+		steps[count] = n;
+		starts[count] = total;
+		total += n;
+		count++;
+	}
+
+	/** Scene that plays when the step count reaches `stepCount`, which is 1 on the first trigger */
+	int find(int stepCount) const {
+		int i = std::lower_bound(starts, starts + count, stepCount) - starts;
+		return std::max(i - 1, 0);
+	}
+};
+
+/** sin(x pi / 2) over [0, 1], tabulated so a crossfade costs two lookups per sample. It's the gain of the signal
+fading in over an equal power crossfade, and the one fading out takes it at 1 - x, so their powers add up to 1.
+*/
+struct CrossfadeCurve {
+	static const int SIZE = 256;
+	float gains[SIZE + 1];
+
+	CrossfadeCurve() {
+		for (int i = 0; i <= SIZE; i++)
+			gains[i] = std::sin(i * (M_PI / 2) / SIZE);
+	}
+
+	float operator()(float x) const {
+		float index = x * SIZE;
+		int i = std::min((int) index, SIZE - 1);
+		return gains[i] + (gains[i + 1] - gains[i]) * (index - i);
+	}
+};
+
+static const CrossfadeCurve crossfadeCurve;
 
 struct Scener : Module {
 	enum ParamId {
@@ -49,6 +112,28 @@ struct Scener : Module {
 
 	float TRIG_TIME = 1e-3f;
 
+	ControlRate controlRate;
+	ProcessTimer timer;
+	float gateRatio = -1.f;
+	float rampDelta = 0.f; // Crossfade ramp increment per sample
+	bool equalPower = true; // Otherwise the crossfade is linear, as in patches saved before the option (see fromJson())
+
+	LightRate lightRate;
+	bool alertsLit[ALERTS] = {}; // Whether the scene is on the step of each alert
+
+	// Without trigger and reset cables Scener follows the transport of an adjacent Klok
+	TransportLink link;
+
+	// The arrangement is edited in the context menu. Without one Scener plays the panel's scenes in order.
+	ArrangedScene arrangement[MAX_SCENES];
+	int arrangedCount = 0;
+	std::atomic<int> arrangementVersion{0}; // Bumped after every edit
+	SceneTable table;
+	// What the table was built from
+	int tableKnobs[ROWS] = {};
+	int tableScenes = -1;
+	int tableVersion = -1;
+
 	Scener() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
 		for (int i = 0; i < SIGNALS; i++) {
@@ -75,43 +160,152 @@ struct Scener : Module {
 		configParam(SCENES_PARAM, 1.f, (float)(ROWS), (float)(ROWS), "Scenes");
 
 		lights[SCENE_LIGHT].setBrightness(1);
+
+		link.setup(this);
+	}
+
+	void onSampleRateChange(const SampleRateChangeEvent& e) override {
+		controlRate.invalidate();
+	}
+
+	void onReset() override {
+		arrangedCount = 0;
+		arrangementVersion++;
+		equalPower = true;
+	}
+
+	void fromJson(json_t* rootJ) override {
+		// Scener saved no data before the option, and Rack only calls dataFromJson() when there is some
+		if (!json_object_get(rootJ, "data"))
+			equalPower = false;
+		Module::fromJson(rootJ);
+	}
+
+	json_t* dataToJson() override {
+		json_t* rootJ = json_object();
+		json_t* arrangementJ = json_array();
+		for (int i = 0; i < arrangedCount; i++) {
+			json_t* sceneJ = json_array();
+			json_array_append_new(sceneJ, json_integer(arrangement[i].row));
+			json_array_append_new(sceneJ, json_integer(arrangement[i].steps));
+			json_array_append_new(arrangementJ, sceneJ);
+		}
+		json_object_set_new(rootJ, "arrangement", arrangementJ);
+		json_object_set_new(rootJ, "equalPower", json_boolean(equalPower));
+		return rootJ;
+	}
+
+	void dataFromJson(json_t* rootJ) override {
+		json_t* arrangementJ = json_object_get(rootJ, "arrangement");
+		if (arrangementJ) {
+			arrangedCount = std::min((int) json_array_size(arrangementJ), MAX_SCENES);
+			for (int i = 0; i < arrangedCount; i++) {
+				json_t* sceneJ = json_array_get(arrangementJ, i);
+				arrangement[i].row = clamp((int) json_integer_value(json_array_get(sceneJ, 0)), 0, ROWS - 1);
+				arrangement[i].steps = clamp((int) json_integer_value(json_array_get(sceneJ, 1)), 0, ARRANGED_STEPS.back());
+			}
+		}
+		arrangementVersion++;
+		json_t* equalPowerJ = json_object_get(rootJ, "equalPower");
+		equalPower = equalPowerJ && json_boolean_value(equalPowerJ);
+	}
+
+	/** Appends a scene to the arrangement, or copies the panel's scenes into it if it's empty. Called from the UI. */
+	void arrangeScene() {
+		if (arrangedCount == 0) {
+			int scenes = params[SCENES_PARAM].getValue();
+			for (int i = 0; i < scenes; i++) {
+				arrangement[i].row = i;
+				arrangement[i].steps = 0;
+			}
+			arrangedCount = scenes;
+		}
+		else if (arrangedCount < MAX_SCENES) {
+			arrangement[arrangedCount] = arrangement[arrangedCount - 1];
+			arrangedCount++;
+		}
+		arrangementVersion++;
+	}
+
+	/** Called from the UI */
+	void removeScene(int i) {
+		for (int j = i; j + 1 < arrangedCount; j++)
+			arrangement[j] = arrangement[j + 1];
+		arrangedCount = std::max(arrangedCount - 1, 0);
+		arrangementVersion++;
+	}
+
+	/** Rebuilds the scene table if a steps knob, the scenes knob or the arrangement changed since it was built */
+	void updateTable(bool force) {
+		bool changed = force || arrangementVersion != tableVersion;
+		int knobs[ROWS];
+		for (int i = 0; i < ROWS; i++) {
+			knobs[i] = params[STEPS_PARAM + i].getValue();
+			changed |= knobs[i] != tableKnobs[i];
+		}
+		int scenes = params[SCENES_PARAM].getValue();
+		changed |= scenes != tableScenes;
+		if (!changed)
+			return;
+
+		tableVersion = arrangementVersion;
+		std::copy(knobs, knobs + ROWS, tableKnobs);
+		tableScenes = scenes;
+		table.clear();
+		if (arrangedCount == 0) {
+			for (int i = 0; i < scenes; i++)
+				table.add(i, knobs[i]);
+		}
+		else {
+			for (int i = 0; i < arrangedCount; i++) {
+				ArrangedScene scene = arrangement[i];
+				table.add(scene.row, scene.steps ? scene.steps : knobs[scene.row]);
+			}
+		}
+		currentScene = std::min(currentScene, table.count - 1);
+		prevScene = std::min(prevScene, table.count - 1);
 	}
 
 	void process(const ProcessArgs& args) override {
-		float inV = inputs[TRIGGER_INPUT].getVoltage();
-		float trigger = edgeDetector.process(inV);
-		float gateRatio = params[TRANSITION_PARAM].getValue();
+		ProcessTimer::Scope timing(timer);
+		bool linked = link.receive(this, args.frame);
+		bool clocked = linked && link.transport.clocked;
+
+		float trigger = 0.f;
+		if (inputs[TRIGGER_INPUT].isConnected())
+			trigger = edgeDetector.process(inputs[TRIGGER_INPUT].getVoltage());
+		else if (clocked)
+			trigger = link.tick(args.frame);
+
+		if (controlRate.process()) {
+			float transition = params[TRANSITION_PARAM].getValue();
+			if (transition != gateRatio || controlRate.forced) {
+				gateRatio = transition;
+				rampDelta = args.sampleTime * (1.f / gateRatio); // Cycles per second
+			}
+			updateTable(controlRate.forced);
+		}
 
 		if (starting) {
 			starting = false;
 			for (int i = 0; i < ALERTS; i++) {
-				float alert = (int)(params[STEPS_PARAM + currentScene].getValue() * params[ALERT_PARAM + i].getValue());
-				lights[ALERT_LIGHT + i].setBrightness(alert == sceneStepCount ? 1.f : 0.f);
+				float alert = (int)(table.steps[currentScene] * params[ALERT_PARAM + i].getValue());
+				alertsLit[i] = alert == sceneStepCount;
 				if (alert == 0) {
 					pgenAlert[i].trigger(TRIG_TIME);
 				}
 			}
 		}
 
-		lights[TRIGGER_LIGHT].setBrightness(0.f);
-
 		if (trigger) {
 			stepCount++;
 			sceneStepCount++;
 			prevScene = currentScene;
-			currentScene = 0;
 
 			pgenTrigger.trigger(0.1);
-			lights[TRIGGER_LIGHT].setBrightness(1.f);
 
-			int totalSteps = 0;
-			for (int i = 0; i < params[SCENES_PARAM].getValue(); i++) {
-				int steps = (int)(params[STEPS_PARAM + i].getValue());
-				if (stepCount > totalSteps) {
-					currentScene = i;
-				}
-				totalSteps += steps;
-			}
+			currentScene = table.find(stepCount);
+			int totalSteps = table.total;
 
 			if (params[LOOP_PARAM].getValue()) {
 				stepCount %= totalSteps;
@@ -126,32 +320,37 @@ struct Scener : Module {
 			}
 
 			for (int i = 0; i < ALERTS; i++) {
-				float alert = (int)(params[STEPS_PARAM + currentScene].getValue() * params[ALERT_PARAM + i].getValue());
-				lights[ALERT_LIGHT + i].setBrightness(alert == sceneStepCount ? 1.f : 0.f);
+				float alert = (int)(table.steps[currentScene] * params[ALERT_PARAM + i].getValue());
+				alertsLit[i] = alert == sceneStepCount;
 				if (alert == sceneStepCount) {
 					pgenAlert[i].trigger(TRIG_TIME);
 				}
 			}
-
-			for (int i = 0; i < ROWS; i++) {
-				lights[SCENE_LIGHT+i].setBrightness(0);
-				if (currentScene == i) {
-					lights[SCENE_LIGHT+i].setBrightness(1);
-				}
-			}	
 		}
 
-		ramp += args.sampleTime * (1.f / gateRatio); // Cycles per second
+		ramp += rampDelta;
 		if (ramp >= 1.f)
 			ramp = 1.f;
 
+		float gainPrev = equalPower ? crossfadeCurve(1.f - ramp) : 1.f - ramp;
+		float gainCurrent = finished ? 0.f : (equalPower ? crossfadeCurve(ramp) : ramp);
+
+		// Inputs are polyphonic. Each output has the channels of the wider of the two rows it blends.
+		int prevRow = table.rows[prevScene];
+		int currentRow = table.rows[currentScene];
 		for (int i = 0; i < COLUMNS; i++) {
-			float a = inputs[SIGNAL_INPUT + ((prevScene * COLUMNS) + i)].getVoltage();
-			float b = inputs[SIGNAL_INPUT + ((currentScene * COLUMNS) + i)].getVoltage();
-			if (finished) {
-				outputs[SIGNAL_OUTPUT + i].setVoltage(a * (1 - ramp));
-			} else {
-				outputs[SIGNAL_OUTPUT + i].setVoltage((a * (1 - ramp)) + (b * ramp));
+			Output& output = outputs[SIGNAL_OUTPUT + i];
+			if (!output.isConnected())
+				continue;
+			Input& a = inputs[SIGNAL_INPUT + ((prevRow * COLUMNS) + i)];
+			Input& b = inputs[SIGNAL_INPUT + ((currentRow * COLUMNS) + i)];
+			int channels = std::max(std::max(a.getChannels(), b.getChannels()), 1);
+			output.setChannels(channels);
+			// Voltages past the channels of a port are 0, so narrower rows blend in as silence
+			for (int c = 0; c < channels; c += 4) {
+				simd::float_4 va = a.getVoltageSimd<simd::float_4>(c);
+				simd::float_4 vb = b.getVoltageSimd<simd::float_4>(c);
+				output.setVoltageSimd(va * gainPrev + vb * gainCurrent, c);
 			}
 		}
 
@@ -159,14 +358,24 @@ struct Scener : Module {
 			outputs[ALERT_OUTPUT + i].setVoltage(10.f * pgenAlert[i].process(args.sampleTime));
 		}
 
-		lights[TRIGGER_LIGHT].setBrightness(pgenTrigger.process(args.sampleTime));	
+		if (lightRate.process()) {
+			// The trigger light stays on for 0.1 s, much longer than an update
+			lights[TRIGGER_LIGHT].setBrightness(pgenTrigger.process(lightRate.getDeltaTime(args.sampleTime)));
+			for (int i = 0; i < ALERTS; i++)
+				lights[ALERT_LIGHT + i].setBrightness(alertsLit[i]);
+			for (int i = 0; i < ROWS; i++)
+				lights[SCENE_LIGHT + i].setBrightness(table.rows[currentScene] == i);
+		}
 
-		if (params[RESET_PARAM].getValue() || edgeDetectorReset.process(inputs[RESET_INPUT].getVoltage())) {
+		bool resetting = inputs[RESET_INPUT].isConnected() ? edgeDetectorReset.process(inputs[RESET_INPUT].getVoltage()) : (clocked && link.reset(args.frame));
+		if (params[RESET_PARAM].getValue() || resetting) {
 			stepCount = 0;
 			currentScene = 0;
 			finished = false;
 		}
 
+		if (linked)
+			link.forward(this, link.transport, args.frame);
 	}
 };
 
@@ -176,9 +385,12 @@ struct ScenerWidget : ModuleWidget {
 		setModule(module);
 		setPanel(createPanel(asset::plugin(pluginInstance, "res/Scener.svg")));
 
+		LabelLayer* labels = new LabelLayer(box.size);
+		addChild(labels);
+
 		float hp = 5.08f;
 
-		addChild(new TextDisplayWidget("Scener", Vec(hp/2, hp*1.5), 14, -1));
+		labels->addLabel("Scener", Vec(hp/2, hp*1.5), 14, -1);
 		addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, 0)));
 		addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
 
@@ -190,22 +402,22 @@ struct ScenerWidget : ModuleWidget {
 		float divYcontrols = hp * 2.8f;
 		float tOffset = 6.f;
 
-		addChild(new TextDisplayWidget("Trigger", Vec(minX4, controlsY - tOffset), 10));
+		labels->addLabel("Trigger", Vec(minX4, controlsY - tOffset), 10);
 		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(minX4, controlsY)), module, Scener::TRIGGER_INPUT));
 		addChild(createLightCentered<MediumLight<RedLight>>(mm2px(Vec(minX4 + divX4, controlsY)), module, Scener::TRIGGER_LIGHT));
-		addChild(new TextDisplayWidget("Scenes", Vec(minX4 + (divX4 * 2), controlsY - tOffset), 10));
+		labels->addLabel("Scenes", Vec(minX4 + (divX4 * 2), controlsY - tOffset), 10);
 		addParam(createParamCentered<RoundSmallBlackSnapKnob>(mm2px(Vec(minX4 + (divX4 * 2), controlsY)), module, Scener::SCENES_PARAM));
 
-		addChild(new TextDisplayWidget("Loop", Vec(minX4, (controlsY + (divYcontrols * 1)) - tOffset), 10));
+		labels->addLabel("Loop", Vec(minX4, (controlsY + (divYcontrols * 1)) - tOffset), 10);
 		addParam(createParamCentered<CKSS>(mm2px(Vec(minX4, (controlsY + (divYcontrols * 1)))), module, Scener::LOOP_PARAM));
-		addChild(new TextDisplayWidget("XFade", Vec(minX4 + (divX4), (controlsY + (divYcontrols * 1)) - tOffset), 10));
+		labels->addLabel("XFade", Vec(minX4 + (divX4), (controlsY + (divYcontrols * 1)) - tOffset), 10);
 		addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(minX4 + (divX4), (controlsY + (divYcontrols * 1)))), module, Scener::TRANSITION_PARAM));
-		addChild(new TextDisplayWidget("Reset", Vec(minX4 + (divX4 * 2.5), (controlsY + (divYcontrols * 1)) - tOffset), 10));
+		labels->addLabel("Reset", Vec(minX4 + (divX4 * 2.5), (controlsY + (divYcontrols * 1)) - tOffset), 10);
 		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(minX4 + (divX4 * 2), (controlsY + (divYcontrols * 1)))), module, Scener::RESET_INPUT));
 		addParam(createParamCentered<VCVButton>(mm2px(Vec(minX4 + (divX4 * 3), (controlsY + (divYcontrols * 1)))), module, Scener::RESET_PARAM));
 
 		for (int i = 0; i < ALERTS; i++) {
-			addChild(new TextDisplayWidget("Alert " + std::to_string(i), Vec(minX4 + (divX4 * (i * 2)), (controlsY + (divYcontrols * 2)) - tOffset), 10));
+			labels->addLabel("Alert " + std::to_string(i), Vec(minX4 + (divX4 * (i * 2)), (controlsY + (divYcontrols * 2)) - tOffset), 10);
 			addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(minX4 + (divX4 * (i * 2)), (controlsY + (divYcontrols * 2)))), module, Scener::ALERT_OUTPUT + i));
 			addChild(createLightCentered<MediumLight<RedLight>>(mm2px(Vec(minX4 + (divX4/2) + (divX4 * (i * 2)), (controlsY + (divYcontrols * 2)))), module, Scener::ALERT_LIGHT + i));
 			addParam(createParamCentered<RoundSmallBlackKnob>(mm2px(Vec(minX4 + (divX4 * ((i * 2) + 1)), (controlsY + (divYcontrols * 2)))), module, Scener::ALERT_PARAM + i));
@@ -222,7 +434,7 @@ struct ScenerWidget : ModuleWidget {
 		}
 
 		for (int i = 0; i < COLUMNS; i++) {
-			addChild(new TextDisplayWidget("Sig" + std::to_string(i), Vec(minX + (divX * i), minY - tOffset), 10));
+			labels->addLabel("Sig" + std::to_string(i), Vec(minX + (divX * i), minY - tOffset), 10);
 			addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(minX + (divX * (i % COLUMNS)), minY + ((ROWS + 0.3f) * divY))), module, Scener::SIGNAL_OUTPUT + i));
 		}
 
@@ -231,6 +443,59 @@ struct ScenerWidget : ModuleWidget {
 			addChild(createLightCentered<MediumLight<RedLight>>(mm2px(Vec(minX + (divX * (COLUMNS + 1)), minY + (i * divY))), module, Scener::SCENE_LIGHT + i));
 		}
 	}
+
+	void appendContextMenu(Menu* menu) override {
+		Scener* module = getModule<Scener>();
+
+		std::vector<std::string> rowLabels;
+		for (int i = 0; i < ROWS; i++)
+			rowLabels.push_back("Row " + std::to_string(i));
+		std::vector<std::string> stepsLabels = {"Steps knob of the row"};
+		for (int steps : ARRANGED_STEPS)
+			stepsLabels.push_back(std::to_string(steps));
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createSubmenuItem("Arrangement", module->arrangedCount ? string::f("%d scenes", module->arrangedCount) : "Off",
+			[=](Menu* menu) {
+				for (int i = 0; i < module->arrangedCount; i++) {
+					ArrangedScene scene = module->arrangement[i];
+					std::string steps = scene.steps ? string::f("%d steps", scene.steps) : "knob steps";
+					menu->addChild(createSubmenuItem("Scene " + std::to_string(i), string::f("row %d, ", scene.row) + steps,
+						[=](Menu* menu) {
+							menu->addChild(createIndexSubmenuItem("Row", rowLabels,
+								[=]() {return (size_t) module->arrangement[i].row;},
+								[=](size_t row) {
+									module->arrangement[i].row = row;
+									module->arrangementVersion++;
+								}
+							));
+							menu->addChild(createIndexSubmenuItem("Steps", stepsLabels,
+								[=]() {
+									auto it = std::find(ARRANGED_STEPS.begin(), ARRANGED_STEPS.end(), module->arrangement[i].steps);
+									return (size_t) (it == ARRANGED_STEPS.end() ? 0 : it - ARRANGED_STEPS.begin() + 1);
+								},
+								[=](size_t index) {
+									module->arrangement[i].steps = index ? ARRANGED_STEPS[index - 1] : 0;
+									module->arrangementVersion++;
+								}
+							));
+							menu->addChild(createMenuItem("Remove", "", [=]() {module->removeScene(i);}));
+						}
+					));
+				}
+				menu->addChild(new MenuSeparator);
+				menu->addChild(createMenuItem(module->arrangedCount ? "Add scene" : "Arrange the panel's scenes", "",
+					[=]() {module->arrangeScene();}, module->arrangedCount >= MAX_SCENES));
+				menu->addChild(createMenuItem("Clear", "",
+					[=]() {
+						module->arrangedCount = 0;
+						module->arrangementVersion++;
+					}, module->arrangedCount == 0));
+			}
+		));
+		menu->addChild(createBoolPtrMenuItem("Equal power crossfade", "", &module->equalPower));
+		module->timer.appendContextMenu(menu, module);
+	}
 };
 
 
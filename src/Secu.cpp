@@ -1,8 +1,17 @@
 #include "plugin.hpp"
+#include <atomic>
 #include <cmath>
 
-const int MAX_STEPS = 8;
+const int MAX_STEPS = 8; // Steps on the panel, one page of the pattern
 const int OUTPUTS = 5;
+const int PATTERN_STEPS = 64;
+const int PATTERN_PAGES = PATTERN_STEPS / MAX_STEPS;
+const int PATTERN_BANKS = 8;
+
+/** Gates of up to 64 steps by 16 tracks. Each step is one word with a bit per track. */
+struct Pattern {
+	uint16_t steps[PATTERN_STEPS] = {};
+};
 
 struct Secu : Module {
 
@@ -27,6 +36,7 @@ struct Secu : Module {
 	};
 	enum OutputId {
 		ENUMS(OUTPUT, OUTPUTS),
+		POLY_OUTPUT,
 		OUTPUTS_LEN
 	};
 	enum LightId {
@@ -41,18 +51,104 @@ struct Secu : Module {
 	dsp::SchmittTrigger edgeDetectorRandom;
 	float restRandomize = 0.0f;
 	float prevRandomizeState = 0.0f;
+	SeededRandom rng;
+
+	ControlRate controlRate;
+	ProcessTimer timer;
+	LightRate lightRate;
+	int stepsLength = MAX_STEPS;
+	float probability = 0.f;
+	int gates = 0; // Bits of the tracks that fire on stepOut
+
+	// The buttons edit one page of the playing bank. Banks chosen in the menu take over on the next step.
+	Pattern banks[PATTERN_BANKS];
+	int bank = 0;
+	std::atomic<int> pendingBank{-1};
+	std::atomic<int> pendingCopy{-1}; // Bank to copy the playing bank into
+	int pages = 1;
+	int editPage = 0;
+	// Page last written to or read from the buttons, so button clicks can be told apart from pattern changes
+	int shownBank = 0;
+	int shownPage = 0;
+	uint16_t shown[MAX_STEPS] = {};
+
+	// Without a trigger cable Secu follows the transport of an adjacent Klok. It picks the step of each tick as soon as
+	// the tick is announced, so it can tell the modules after it which tracks fire before the tick happens.
+	TransportLink link;
+	dsp::PulseGenerator pgen;
+	int64_t plannedTick = -1;
+	int plannedStep = 0;
+	int plannedGates = 0; // Bits of the tracks that fire on plannedStep
+	int64_t firedTick = -1; // Frame of the last step taken, announced to the next modules when there's no plan
+	int firedGates = 0;
 
 	ParamId COLUMNS[5] = {COLUMN0_PARAM,  COLUMN1_PARAM,  COLUMN2_PARAM,  COLUMN3_PARAM,  COLUMN4_PARAM};
 
+	/** Randomizes the panel tracks of the steps in use, keeping the rest of the pattern */
 	void randomizeSteps() {
+		float sparseness = params[SPARSERND_PARAM].getValue();
+		uint16_t* steps = banks[bank].steps;
+		for (int i = 0; i < pages * MAX_STEPS; i++) {
+			uint16_t word = steps[i] & ~((1 << OUTPUTS) - 1);
+			for (int j = 0; j < OUTPUTS; j++) {
+				if (sparseness > rng.uniform())
+					word |= 1 << j;
+			}
+			steps[i] = word;
+		}
+		shownBank = -1;
+		gates = gateBits(stepOut);
+		updatePlannedGates();
+	}
+
+	/** Picks the next step, a random one with the probability set on the panel. A bank chosen in the menu starts
+	playing here, so it always takes over on a step boundary.
+	*/
+	int chooseStep() {
+		int next = pendingBank.exchange(-1);
+		if (next >= 0)
+			bank = next;
+		float chance = clamp(probability + inputs[PROB_INPUT].getVoltage(), 0.0f, 1.0f) > rng.uniform();
+		return chance ? int(floor(rng.uniform() * stepsLength)) : stepNr;
+	}
+
+	int gateBits(int step) {
+		return banks[bank].steps[step];
+	}
+
+	/** Keeps the buttons and the shown page of the pattern in step. Clicked buttons are written to the pattern, and
+	the buttons follow the pattern when the bank, the page or the pattern itself changes.
+	*/
+	void syncButtons() {
+		int page = std::min(editPage, pages - 1);
+		uint16_t* steps = &banks[bank].steps[page * MAX_STEPS];
+		if (bank != shownBank || page != shownPage) {
+			for (int i = 0; i < MAX_STEPS; i++) {
+				shown[i] = steps[i] & ((1 << OUTPUTS) - 1);
+				for (int j = 0; j < OUTPUTS; j++)
+					params[COLUMNS[j] + i].setValue((shown[i] >> j) & 1);
+			}
+			shownBank = bank;
+			shownPage = page;
+			return;
+		}
 		for (int i = 0; i < MAX_STEPS; i++) {
-			for (int j = 0; j < 5; j++) {
-				bool on = params[SPARSERND_PARAM].getValue() > random::uniform();
-				params[COLUMNS[j] + i].setValue(on ? 1.f : 0.f);
+			uint16_t word = 0;
+			for (int j = 0; j < OUTPUTS; j++) {
+				if (params[COLUMNS[j] + i].getValue() >= 0.1)
+					word |= 1 << j;
+			}
+			if (word != shown[i]) {
+				steps[i] = (steps[i] & ~((1 << OUTPUTS) - 1)) | word;
+				shown[i] = word;
 			}
 		}
 	}
 
+	void updatePlannedGates() {
+		plannedGates = gateBits(plannedStep);
+	}
+
 	Secu() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
 
@@ -72,18 +168,106 @@ struct Secu : Module {
 		configInput(PROB_INPUT, "Probability");
 		configInput(RANDOM_INPUT, "Randomize");
 
+		link.setup(this);
+
 		for (int i = 0; i < OUTPUTS; i++) {
 			configOutput(OUTPUT + i, "Trigger " + std::to_string(i));
 		}
+		configOutput(POLY_OUTPUT, "Polyphonic triggers");
+	}
+
+	void onSampleRateChange(const SampleRateChangeEvent& e) override {
+		controlRate.invalidate();
+	}
+
+	void onReset() override {
+		for (int i = 0; i < PATTERN_BANKS; i++)
+			banks[i] = Pattern();
+		bank = 0;
+		pendingBank = -1;
+		pendingCopy = -1;
+		pages = 1;
+		editPage = 0;
+		shownBank = -1;
+		rng.fixedSeed = 0;
+	}
+
+	json_t* dataToJson() override {
+		json_t* rootJ = json_object();
+		json_t* banksJ = json_array();
+		for (int i = 0; i < PATTERN_BANKS; i++) {
+			json_t* stepsJ = json_array();
+			for (int k = 0; k < PATTERN_STEPS; k++)
+				json_array_append_new(stepsJ, json_integer(banks[i].steps[k]));
+			json_array_append_new(banksJ, stepsJ);
+		}
+		json_object_set_new(rootJ, "banks", banksJ);
+		int next = pendingBank;
+		json_object_set_new(rootJ, "bank", json_integer(next >= 0 ? next : bank));
+		json_object_set_new(rootJ, "pages", json_integer(pages));
+		json_object_set_new(rootJ, "editPage", json_integer(editPage));
+		rng.dataToJson(rootJ);
+		return rootJ;
+	}
+
+	void dataFromJson(json_t* rootJ) override {
+		json_t* banksJ = json_object_get(rootJ, "banks");
+		if (banksJ) {
+			for (int i = 0; i < PATTERN_BANKS; i++) {
+				json_t* stepsJ = json_array_get(banksJ, i);
+				for (int k = 0; k < PATTERN_STEPS; k++)
+					banks[i].steps[k] = json_integer_value(json_array_get(stepsJ, k));
+			}
+			// The saved pattern wins over the saved buttons. Patches from before pattern banks only have the buttons,
+			// which sync into the store as usual.
+			shownBank = -1;
+		}
+		json_t* bankJ = json_object_get(rootJ, "bank");
+		if (bankJ)
+			bank = clamp((int) json_integer_value(bankJ), 0, PATTERN_BANKS - 1);
+		json_t* pagesJ = json_object_get(rootJ, "pages");
+		if (pagesJ)
+			pages = clamp((int) json_integer_value(pagesJ), 1, PATTERN_PAGES);
+		json_t* editPageJ = json_object_get(rootJ, "editPage");
+		if (editPageJ)
+			editPage = clamp((int) json_integer_value(editPageJ), 0, PATTERN_PAGES - 1);
+		pendingBank = -1;
+		rng.dataFromJson(rootJ);
 	}
 
 	void process(const ProcessArgs& args) override {
+		ProcessTimer::Scope timing(timer);
+		bool clocked = link.receive(this, args.frame) && link.transport.clocked;
+		bool followTransport = clocked && !inputs[TRIGGER_INPUT].isConnected();
+
 		float inV = inputs[TRIGGER_INPUT].getVoltage();
-		float trigger = edgeDetector.process(inV);
-		int stepsLength = params[STEPS_PARAM].getValue();
+		float trigger = followTransport ? link.tick(args.frame) : edgeDetector.process(inV);
+
+		if (controlRate.process()) {
+			// The knob sets the length of the last page
+			stepsLength = (pages - 1) * MAX_STEPS + params[STEPS_PARAM].getValue();
+			probability = params[PROB_PARAM].getValue();
+			int copy = pendingCopy.exchange(-1);
+			if (copy >= 0)
+				banks[copy] = banks[bank];
+			syncButtons();
+			// Catches gate buttons clicked while their step is playing
+			gates = gateBits(stepOut);
+			updatePlannedGates();
+		}
 
-		if (edgeDetectorReset.process(inputs[RESET_INPUT].getVoltage())) {
+		bool resetting = inputs[RESET_INPUT].isConnected() ? edgeDetectorReset.process(inputs[RESET_INPUT].getVoltage()) : (clocked && link.reset(args.frame));
+		if (resetting) {
 			stepNr = 0;
+			plannedTick = -1;
+			// With a fixed seed the random steps repeat from every reset
+			rng.restart();
+		}
+
+		if (followTransport && !trigger && link.transport.running && link.transport.nextTick != plannedTick) {
+			plannedTick = link.transport.nextTick;
+			plannedStep = chooseStep();
+			updatePlannedGates();
 		}
 
 		if (params[RANDOM_PARAM].getValue() > 0.1) {
@@ -102,40 +286,254 @@ struct Secu : Module {
 		}
 
 		if (trigger) {
-			float chance = clamp(params[PROB_PARAM].getValue() + inputs[PROB_INPUT].getVoltage(), 0.0f, 1.0f) > random::uniform();
-			stepOut = chance ? int(floor(random::uniform() * stepsLength)) : stepNr;
-			
-			for (int i = 0; i < MAX_STEPS; i++) {
-				if (stepOut == i) {
-					lights[STEPLIGHT+stepOut].setSmoothBrightness(trigger, 5e-6f);
-				} else {
-					lights[STEPLIGHT+i].setBrightness(0);
-				}
-			}
+			stepOut = (followTransport && plannedTick == link.lastTick) ? plannedStep : chooseStep();
+			firedTick = args.frame;
+			gates = gateBits(stepOut);
+			firedGates = gates;
+			if (followTransport)
+				pgen.trigger(1e-3f);
 
 			stepNr++;
 			stepNr = stepNr % stepsLength;
 		}
-		
-		for (int j = 0; j < 5; j++) {
+
+		// Gates pass the trigger input through, or a 1 ms pulse on transport ticks
+		float gateV = followTransport ? 10.f * pgen.process(args.sampleTime) : inV;
+		for (int j = 0; j < OUTPUTS; j++) {
 			outputs[OUTPUT+j].setVoltage(0.0f);
-			if (params[COLUMNS[j] + stepOut].getValue() >= 0.1 && outputs[OUTPUT+j].isConnected()) {
-				outputs[OUTPUT+j].setVoltage(inV);
+			if (((gates >> j) & 1) && outputs[OUTPUT+j].isConnected()) {
+				outputs[OUTPUT+j].setVoltage(gateV);
 			}
 		}
+		// The poly output carries every track, a channel each
+		outputs[POLY_OUTPUT].setChannels(OUTPUTS);
+		if (outputs[POLY_OUTPUT].isConnected()) {
+			for (int j = 0; j < OUTPUTS; j++)
+				outputs[POLY_OUTPUT].setVoltage(((gates >> j) & 1) ? gateV : 0.f, j);
+		}
 		prevRandomizeState = params[RANDOM_PARAM].getValue();
+
+		if (lightRate.process()) {
+			// Lights the step taken last, if it's on the page shown
+			int pageStart = std::min(editPage, pages - 1) * MAX_STEPS;
+			for (int i = 0; i < MAX_STEPS; i++)
+				lights[STEPLIGHT + i].setBrightness(firedTick >= 0 && stepOut == pageStart + i);
+		}
+
+		// Tell the next modules which tracks fire: ahead of time when following the transport, otherwise as they fire
+		TransportMessage message = link.transport;
+		bool planned = followTransport && plannedTick > args.frame;
+		message.gatesTick = planned ? plannedTick : firedTick;
+		message.gates = planned ? plannedGates : firedGates;
+		link.forward(this, message, args.frame);
 	}
 	
 };
 
 
+/** The step buttons and the playhead of Secu as one widget. The whole matrix is drawn in one pass into a
+framebuffer, which is only redrawn when a gate or the playing step changes. Clicking a cell toggles it, and dragging
+from there paints the cells passed over with the same state, as one undo action. The cells are the COLUMN params, so
+the module syncs them into the pattern as it did with separate buttons.
+*/
+struct StepGrid : Widget {
+	struct Drawing : Widget {
+		StepGrid* grid;
+		void draw(const DrawArgs& args) override {
+			grid->drawGrid(args);
+		}
+	};
+
+	Secu* module;
+	int rows;
+	int columns;
+	Vec pitch; // Between cell centres
+	FramebufferWidget* fb;
+
+	// What the framebuffer shows
+	std::vector<bool> drawnCells;
+	int drawnStep = -1;
+
+	bool paintValue = false;
+	history::ComplexAction* paintAction = NULL; // Changes of the drag going on
+
+	/** A grid of `rows` steps by `columns` tracks, with the centre of the first cell at `first` */
+	StepGrid(Secu* module, Vec first, Vec pitch, int rows, int columns) : module(module), rows(rows), columns(columns), pitch(pitch) {
+		box.pos = first.minus(pitch.div(2));
+		box.size = Vec(pitch.x * columns, pitch.y * rows);
+		drawnCells.resize(rows * columns);
+
+		fb = new FramebufferWidget;
+		fb->box.size = box.size;
+		addChild(fb);
+		Drawing* drawing = new Drawing;
+		drawing->grid = this;
+		drawing->box.size = box.size;
+		fb->addChild(drawing);
+	}
+
+	~StepGrid() {
+		delete paintAction;
+	}
+
+	int paramId(int row, int column) {
+		return Secu::COLUMN0_PARAM + column * MAX_STEPS + row;
+	}
+
+	bool getCell(int row, int column) {
+		return module && module->params[paramId(row, column)].getValue() >= 0.1f;
+	}
+
+	void setCell(int row, int column, bool value) {
+		if (getCell(row, column) == value)
+			return;
+		history::ParamChange* change = new history::ParamChange;
+		change->moduleId = module->id;
+		change->paramId = paramId(row, column);
+		change->oldValue = module->params[change->paramId].getValue();
+		change->newValue = value;
+		module->params[change->paramId].setValue(value);
+		paintAction->push(change);
+	}
+
+	/** The cell at `pos`, if there's one */
+	bool cellAt(Vec pos, int& row, int& column) {
+		if (!box.zeroPos().contains(pos))
+			return false;
+		row = clamp((int) (pos.y / pitch.y), 0, rows - 1);
+		column = clamp((int) (pos.x / pitch.x), 0, columns - 1);
+		return true;
+	}
+
+	/** The step whose light the module turned on, or -1 */
+	int getPlayingStep() {
+		if (!module)
+			return -1;
+		for (int i = 0; i < rows; i++) {
+			if (module->lights[Secu::STEPLIGHT + i].getBrightness() > 0.5f)
+				return i;
+		}
+		return -1;
+	}
+
+	void step() override {
+		bool changed = false;
+		for (int row = 0; row < rows; row++) {
+			for (int column = 0; column < columns; column++) {
+				bool cell = getCell(row, column);
+				if (cell != drawnCells[row * columns + column]) {
+					drawnCells[row * columns + column] = cell;
+					changed = true;
+				}
+			}
+		}
+		int playing = getPlayingStep();
+		if (playing != drawnStep) {
+			drawnStep = playing;
+			changed = true;
+		}
+		if (changed)
+			fb->setDirty();
+		Widget::step();
+	}
+
+	void onButton(const ButtonEvent& e) override {
+		// Right clicks fall through to the module's menu
+		int row, column;
+		if (!module || e.button != GLFW_MOUSE_BUTTON_LEFT || e.action != GLFW_PRESS || !cellAt(e.pos, row, column))
+			return;
+		paintValue = !getCell(row, column);
+		delete paintAction;
+		paintAction = new history::ComplexAction;
+		paintAction->name = "paint Secu steps";
+		setCell(row, column, paintValue);
+		e.consume(this);
+	}
+
+	void onDragHover(const DragHoverEvent& e) override {
+		int row, column;
+		if (e.origin == this && paintAction && cellAt(e.pos, row, column)) {
+			setCell(row, column, paintValue);
+			e.consume(this);
+		}
+	}
+
+	void onDragEnd(const DragEndEvent& e) override {
+		if (!paintAction)
+			return;
+		if (paintAction->isEmpty())
+			delete paintAction;
+		else
+			APP->history->push(paintAction);
+		paintAction = NULL;
+	}
+
+	Vec cellCenter(int row, int column) {
+		return Vec(pitch.x * (column + 0.5f), pitch.y * (row + 0.5f));
+	}
+
+	/** Draws the cells like the buttons they replace: a bezel lit from below when off and from above when on, around
+	a grey or blue cap. Cells sharing a fill go in one path.
+	*/
+	void drawGrid(const DrawArgs& args) {
+		const float radius = 9.f;
+		const float capRadius = 7.37f;
+		NVGcolor light = nvgRGB(0xa7, 0xa7, 0xa7);
+		NVGcolor dark = nvgRGB(0x03, 0x03, 0x03);
+
+		if (drawnStep >= 0) {
+			// The playhead glows around the cells of its step
+			for (int column = 0; column < columns; column++) {
+				Vec c = cellCenter(drawnStep, column);
+				nvgBeginPath(args.vg);
+				nvgCircle(args.vg, c.x, c.y, radius * 2.f);
+				nvgFillPaint(args.vg, nvgRadialGradient(args.vg, c.x, c.y, radius, radius * 2.f, nvgTransRGBA(SCHEME_RED, 160), nvgTransRGBA(SCHEME_RED, 0)));
+				nvgFill(args.vg);
+			}
+		}
+
+		for (int row = 0; row < rows; row++) {
+			float y = cellCenter(row, 0).y;
+			for (int on = 0; on < 2; on++) {
+				nvgBeginPath(args.vg);
+				for (int column = 0; column < columns; column++) {
+					if (drawnCells[row * columns + column] == (bool) on) {
+						Vec c = cellCenter(row, column);
+						nvgCircle(args.vg, c.x, c.y, radius);
+					}
+				}
+				nvgFillPaint(args.vg, nvgLinearGradient(args.vg, 0.f, y - radius, 0.f, y + radius, on ? light : dark, on ? dark : light));
+				nvgFill(args.vg);
+			}
+		}
+
+		for (int on = 0; on < 2; on++) {
+			nvgBeginPath(args.vg);
+			for (int row = 0; row < rows; row++) {
+				for (int column = 0; column < columns; column++) {
+					if (drawnCells[row * columns + column] == (bool) on) {
+						Vec c = cellCenter(row, column);
+						nvgCircle(args.vg, c.x, c.y, capRadius);
+					}
+				}
+			}
+			nvgFillColor(args.vg, on ? nvgRGB(0x00, 0xa4, 0xe9) : nvgRGB(0x2e, 0x2e, 0x2e));
+			nvgFill(args.vg);
+		}
+	}
+};
+
+
 struct SecuWidget : ModuleWidget {
 	SecuWidget(Secu* module) {
 		setModule(module);
 		setPanel(createPanel(asset::plugin(pluginInstance, "res/Secu.svg")));
 
+		LabelLayer* labels = new LabelLayer(box.size);
+		addChild(labels);
+
 		float hp = 5.08f;
-		addChild(new TextDisplayWidget("Secu", Vec(hp/2, hp*1.5), 14, -1));
+		labels->addLabel("Secu", Vec(hp/2, hp*1.5), 14, -1);
 		addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, 0)));
 		addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
 
@@ -146,36 +544,32 @@ struct SecuWidget : ModuleWidget {
 		float div3 = (maxX3 - minX3) / 3.f;
 		float tOffset = 6.f;
 
-		addChild(new TextDisplayWidget("Rst", Vec(minX3, inputsY - tOffset), 10));
+		labels->addLabel("Rst", Vec(minX3, inputsY - tOffset), 10);
 		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(minX3, inputsY)), module, Secu::RESET_INPUT));
-		addChild(new TextDisplayWidget("Trig", Vec(minX3 + div3, inputsY - tOffset), 10));
+		labels->addLabel("Trig", Vec(minX3 + div3, inputsY - tOffset), 10);
 		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(minX3 + div3, inputsY)), module, Secu::TRIGGER_INPUT));
 
-		addChild(new TextDisplayWidget("Rnd", Vec(minX3 + (div3 * 2), inputsY - tOffset), 10));
+		labels->addLabel("Rnd", Vec(minX3 + (div3 * 2), inputsY - tOffset), 10);
 		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(minX3 + (div3 * 2), inputsY)), module, Secu::RANDOM_INPUT));
 		addParam(createParamCentered<VCVButton>(mm2px(Vec(minX3 + (div3 * 2), inputsY + divY)), module, Secu::RANDOM_PARAM));
 		addParam(createParamCentered<RoundSmallBlackKnob>(mm2px(Vec(minX3 + (div3 * 2), inputsY + (divY * 2))), module, Secu::SPARSERND_PARAM));
 
-		addChild(new TextDisplayWidget("Prob", Vec(minX3 + (div3 * 0.5f), inputsY + divY - tOffset), 10));
+		labels->addLabel("Prob", Vec(minX3 + (div3 * 0.5f), inputsY + divY - tOffset), 10);
 		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(minX3, inputsY + divY)), module, Secu::PROB_INPUT));
 		addParam(createParamCentered<RoundSmallBlackKnob>(mm2px(Vec(minX3 + div3, inputsY + divY)), module, Secu::PROB_PARAM));
 		
-		addChild(new TextDisplayWidget("Steps", Vec(minX3 + div3, inputsY + (divY * 2) - tOffset), 10));
+		labels->addLabel("Steps", Vec(minX3 + div3, inputsY + (divY * 2) - tOffset), 10);
 		addParam(createParamCentered<RoundSmallBlackSnapKnob>(mm2px(Vec(minX3 + div3, inputsY + (divY * 2))), module, Secu::STEPS_PARAM));
 
+		labels->addLabel("Poly", Vec(minX3, inputsY + (divY * 2) - tOffset), 10);
+		addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(minX3, inputsY + (divY * 2))), module, Secu::POLY_OUTPUT));
+
 		float btnY = 54.f;
 		float btnX = hp*1.3;
 		float divXBtn = 7.f;
 		float divYBtn = 7.f;
 
-		Secu::ParamId COLUMNS[5] = {Secu::COLUMN0_PARAM,  Secu::COLUMN1_PARAM,  Secu::COLUMN2_PARAM,  Secu::COLUMN3_PARAM,  Secu::COLUMN4_PARAM};
-
-		for (int i = 0; i < MAX_STEPS; i++) {
-			for (int j = 0; j < 5; j++) {
-				addChild(createLightCentered<MediumLight<RedLight>>(mm2px(Vec(btnX + (divXBtn * j), btnY + (divYBtn * i))), module, Secu::STEPLIGHT + i));
-				addParam(createParamCentered<StateButton>(mm2px(Vec(btnX + (divXBtn * j), btnY + (divYBtn * i))), module, COLUMNS[j] + i));
-			}
-		}
+		addChild(new StepGrid(module, mm2px(Vec(btnX, btnY)), mm2px(Vec(divXBtn, divYBtn)), MAX_STEPS, OUTPUTS));
 
 		float outY = 112.f;
 		float divYOut = 8.f;
@@ -186,6 +580,43 @@ struct SecuWidget : ModuleWidget {
 		addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(13.425, outY + divYOut)), module, Secu::OUTPUT+1));
 		addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(27.445, outY + divYOut)), module, Secu::OUTPUT+3));
 	}
+
+	void appendContextMenu(Menu* menu) override {
+		Secu* module = getModule<Secu>();
+
+		std::vector<std::string> bankLabels;
+		for (int i = 0; i < PATTERN_BANKS; i++)
+			bankLabels.push_back(string::f("%d", i + 1));
+		std::vector<std::string> pageLabels;
+		for (int i = 0; i < PATTERN_PAGES; i++)
+			pageLabels.push_back(string::f("%d (%d steps)", i + 1, (i + 1) * MAX_STEPS));
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createIndexSubmenuItem("Pattern bank", bankLabels,
+			[=]() {
+				int next = module->pendingBank;
+				return (size_t) (next >= 0 ? next : module->bank);
+			},
+			[=](size_t i) {module->pendingBank = i;}
+		));
+		menu->addChild(createSubmenuItem("Copy pattern to bank", "",
+			[=](Menu* menu) {
+				for (int i = 0; i < PATTERN_BANKS; i++) {
+					menu->addChild(createMenuItem(bankLabels[i], "", [=]() {module->pendingCopy = i;}, i == module->bank));
+				}
+			}
+		));
+		menu->addChild(createIndexSubmenuItem("Pages", pageLabels,
+			[=]() {return (size_t) (module->pages - 1);},
+			[=](size_t i) {module->pages = i + 1;}
+		));
+		menu->addChild(createIndexSubmenuItem("Edit page", std::vector<std::string>(bankLabels.begin(), bankLabels.begin() + module->pages),
+			[=]() {return (size_t) std::min(module->editPage, module->pages - 1);},
+			[=](size_t i) {module->editPage = i;}
+		));
+		module->rng.appendContextMenu(menu);
+		module->timer.appendContextMenu(menu, module);
+	}
 };
 
 
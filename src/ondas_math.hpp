@@ -0,0 +1,122 @@
+#pragma once
+#include <rack.hpp>
+
+using namespace rack;
+
+// Fast approximations of the transcendental functions Ondas uses on the audio path, so every module runs the same
+// code for them at the same cost, whatever libm or the SDK's vector math do on the platform.
+//
+// Every function is a template for float and simd::float_4, evaluated the same way for both, so a scalar and a vector
+// path give identical results. They are polynomials rather than lookup tables: SSE has no gather, so a table costs a
+// scalar load per lane, and the polynomials are as accurate as a float allows anyway. headless/math.cpp checks the
+// error bounds below against libm and times each function (`make math-check`).
+
+namespace fastmath {
+
+const float LOG2E = 1.44269504089f;
+const float LN2 = 0.69314718056f;
+const float SQRT2 = 1.41421356237f;
+
+template <typename T>
+struct Bits;
+template <>
+struct Bits<float> {
+	typedef int32_t type;
+};
+template <>
+struct Bits<simd::float_4> {
+	typedef simd::int32_4 type;
+};
+
+inline float fromBits(int32_t i) {
+	float x;
+	std::memcpy(&x, &i, sizeof(x));
+	return x;
+}
+inline simd::float_4 fromBits(simd::int32_4 i) {
+	return simd::float_4::cast(i);
+}
+inline int32_t toBits(float x) {
+	int32_t i;
+	std::memcpy(&i, &x, sizeof(i));
+	return i;
+}
+inline simd::int32_4 toBits(simd::float_4 x) {
+	return simd::int32_4::cast(x);
+}
+
+// std::fmin and std::fmax handle NaN, which keeps them from compiling to one instruction
+inline float clamp(float x, float a, float b) {
+	return std::min(std::max(x, a), b);
+}
+inline simd::float_4 clamp(simd::float_4 x, float a, float b) {
+	return simd::clamp(x, a, b);
+}
+
+/** 2^x. Relative error below 3e-7. x is clamped to [-126, 126], so the result is always a normal float. */
+template <typename T>
+T exp2(T x) {
+	typedef typename Bits<T>::type I;
+	x = clamp(x, -126.f, 126.f);
+	// 2^x = 2^n 2^f with n an integer and |f| <= 1/2. 2^f is a degree 5 minimax polynomial.
+	T n = simd::floor(x + 0.5f);
+	T f = x - n;
+	T p = 1.327647198e-3f;
+	p = p * f + 9.675541334e-3f;
+	p = p * f + 5.550713274e-2f;
+	p = p * f + 2.402211972e-1f;
+	p = p * f + 6.931469671e-1f;
+	p = p * f + 1.000000072e+0f;
+	return p * fromBits((I(n) + 127) << 23);
+}
+
+/** log2(x) for positive, normal x. Error below 2e-7, absolute for results up to 1 and relative beyond. */
+template <typename T>
+T log2(T x) {
+	typedef typename Bits<T>::type I;
+	// x = 2^e m with m in [sqrt(1/2), sqrt(2)), and log2(m) = 2 atanh(t) / ln 2 with t = (m - 1) / (m + 1), which is
+	// t times a degree 3 minimax polynomial in t^2
+	I bits = toBits(x);
+	T e = T((bits >> 23) - 127);
+	T m = fromBits((bits & 0x007fffff) | 0x3f800000);
+	auto big = m > SQRT2;
+	m = simd::ifelse(big, m * 0.5f, m);
+	e = simd::ifelse(big, e + 1.f, e);
+	T t = (m - 1.f) / (m + 1.f);
+	T t2 = t * t;
+	T p = 4.317307730e-1f;
+	p = p * t2 + 5.767146470e-1f;
+	p = p * t2 + 9.617988438e-1f;
+	p = p * t2 + 2.885390080e+0f;
+	return e + t * p;
+}
+
+/** a^b for positive a. Relative error below 2e-6 while |b log2(a)| stays under 16. Powers of 2 are cheaper with exp2(). */
+template <typename T>
+T pow(T a, T b) {
+	return exp2(b * log2(a));
+}
+
+/** tanh(x), as 1 - 2 / (e^2x + 1). Absolute error below 3e-7. */
+template <typename T>
+T tanh(T x) {
+	return 1.f - 2.f / (exp2(x * (2.f * LOG2E)) + 1.f);
+}
+
+/** sin(2 pi x) for any x, as a degree 9 polynomial on the folded phase. Absolute error below 4e-6. */
+template <typename T>
+T sin2pi(T x) {
+	x -= simd::round(x); // Wrap to [-0.5, 0.5]
+	x = simd::ifelse(x > 0.25f, 0.5f - x, x); // Fold to [-0.25, 0.25]
+	x = simd::ifelse(x < -0.25f, -0.5f - x, x);
+	T x2 = x * x;
+	return x * (6.28318531f + x2 * (-41.3417022f + x2 * (81.6052493f + x2 * (-76.7058598f + x2 * 42.0586939f))));
+}
+
+/** cos(2 pi x) for any x */
+template <typename T>
+T cos2pi(T x) {
+	return sin2pi(x + 0.25f);
+}
+
+} // namespace fastmath
@@ -0,0 +1,186 @@
+#pragma once
+#include <rack.hpp>
+
+using namespace rack;
+
+// Oversampling for the nonlinear stages of Ondas modules (drive, bitcrush, waveshaping), so they don't alias at 44.1
+// or 48 kHz without running the whole engine at a higher sample rate.
+//
+// Each 2x step is a polyphase half-band lowpass: every other tap of a half-band filter is zero except the center one,
+// which is 0.5, so one phase is a plain delay and the other a short symmetric FIR. 4x and 8x cascade more steps.
+// The first step carries the steep filter around the audio band; later steps only have to reject images an octave
+// or more away and get by with short kernels.
+
+// Half of the nonzero, symmetric taps of two Kaiser windowed half-band filters, normalized so they sum to 0.5.
+// 47 taps, beta 6.5: 0.005 dB ripple up to 18 kHz and 66 dB of rejection from 26.1 kHz at 44.1 kHz
+static const float HALFBAND_STEEP[12] = {
+	-1.302049748e-04f, 5.272675806e-04f, -1.334735710e-03f, 2.766875657e-03f,
+	-5.097387088e-03f, 8.684495061e-03f, -1.403836546e-02f, 2.200158713e-02f,
+	-3.426941011e-02f, 5.519293653e-02f, -1.008259354e-01f, 3.165228768e-01f,
+};
+// 15 taps, beta 5.4: 54 dB of rejection from 3/8 of the sample rate, for the steps after the first
+static const float HALFBAND_SHORT[4] = {
+	-1.163878772e-03f, 1.523395792e-02f, -6.640419979e-02f, 3.023341206e-01f,
+};
+
+/** The last N samples pushed, newest first, stored twice so they can always be read as one contiguous array. */
+template <typename T, int N>
+struct TDelayLine {
+	T buffer[2 * N] = {};
+	int pos = 0;
+
+	void reset() {
+		for (int i = 0; i < 2 * N; i++)
+			buffer[i] = 0.f;
+		pos = 0;
+	}
+
+	void push(T x) {
+		pos = (pos == 0 ? N : pos) - 1;
+		buffer[pos] = buffer[pos + N] = x;
+	}
+
+	/** Sample pushed `i` pushes ago */
+	T operator[](int i) const {
+		return buffer[pos + i];
+	}
+
+	/** Convolves the line with a symmetric kernel of N taps, given by its first half. */
+	T convolve(const float* kernel) const {
+		const T* x = &buffer[pos];
+		T y = 0.f;
+		for (int t = 0; t < N / 2; t++)
+			y += kernel[t] * (x[t] + x[N - 1 - t]);
+		return y;
+	}
+};
+
+/** Doubles the sample rate. Each input sample becomes two output samples. */
+template <typename T, int N>
+struct THalfBandUpsampler {
+	TDelayLine<T, N> x;
+
+	void reset() {
+		x.reset();
+	}
+
+	void process(T in, T* out, const float* kernel) {
+		x.push(in);
+		// Gain of 2 makes up for the zeros stuffed between samples
+		out[0] = 2.f * x.convolve(kernel);
+		out[1] = x[N / 2 - 1];
+	}
+};
+
+/** Halves the sample rate. Each pair of input samples becomes one output sample. */
+template <typename T, int N>
+struct THalfBandDownsampler {
+	TDelayLine<T, N> even;
+	TDelayLine<T, N> odd;
+
+	void reset() {
+		even.reset();
+		odd.reset();
+	}
+
+	T process(const T* in, const float* kernel) {
+		even.push(in[0]);
+		odd.push(in[1]);
+		return odd.convolve(kernel) + 0.5f * even[N / 2 - 1];
+	}
+};
+
+/** Runs a nonlinear function at 1, 2, 4 or 8 times the engine sample rate.
+T is float or simd::float_4, in which case every lane is a separate channel.
+A factor above 1 delays the signal by about 23 samples at 2x and 28 at 8x, so a dry signal mixed with the output should
+go through the oversampled function too.
+*/
+template <typename T = float>
+struct TOversampler {
+	static const int MAX_FACTOR = 8;
+
+	int factor = 1;
+	THalfBandUpsampler<T, 24> up1;
+	THalfBandUpsampler<T, 8> up2;
+	THalfBandUpsampler<T, 8> up3;
+	THalfBandDownsampler<T, 24> down1;
+	THalfBandDownsampler<T, 8> down2;
+	THalfBandDownsampler<T, 8> down3;
+
+	void reset() {
+		up1.reset();
+		up2.reset();
+		up3.reset();
+		down1.reset();
+		down2.reset();
+		down3.reset();
+	}
+
+	/** Sets the factor to 1, 2, 4 or 8, clearing the filters if it changes. */
+	void setFactor(int factor) {
+		factor = (factor >= 8) ? 8 : (factor >= 4) ? 4 : (factor >= 2) ? 2 : 1;
+		if (factor == this->factor)
+			return;
+		this->factor = factor;
+		reset();
+	}
+
+	/** Writes `factor` samples to `out` */
+	void upsample(T in, T* out) {
+		if (factor == 1) {
+			out[0] = in;
+			return;
+		}
+		T x2[2];
+		up1.process(in, factor == 2 ? out : x2, HALFBAND_STEEP);
+		if (factor == 2)
+			return;
+		T x4[4];
+		for (int i = 0; i < 2; i++)
+			up2.process(x2[i], factor == 4 ? &out[2 * i] : &x4[2 * i], HALFBAND_SHORT);
+		if (factor == 4)
+			return;
+		for (int i = 0; i < 4; i++)
+			up3.process(x4[i], &out[2 * i], HALFBAND_SHORT);
+	}
+
+	/** Reads `factor` samples from `in` */
+	T downsample(const T* in) {
+		if (factor == 1)
+			return in[0];
+		T x4[4];
+		T x2[2];
+		if (factor == 8) {
+			for (int i = 0; i < 4; i++)
+				x4[i] = down3.process(&in[2 * i], HALFBAND_SHORT);
+			in = x4;
+		}
+		if (factor >= 4) {
+			for (int i = 0; i < 2; i++)
+				x2[i] = down2.process(&in[2 * i], HALFBAND_SHORT);
+			in = x2;
+		}
+		return down1.process(in, HALFBAND_STEEP);
+	}
+
+	/** Returns f(in), with f evaluated at the oversampled rate. */
+	template <typename F>
+	T process(T in, F f) {
+		if (factor == 1)
+			return f(in);
+		T buffer[MAX_FACTOR];
+		upsample(in, buffer);
+		for (int i = 0; i < factor; i++)
+			buffer[i] = f(buffer[i]);
+		return downsample(buffer);
+	}
+};
+
+typedef TOversampler<> Oversampler;
+
+// Context menu choices for the oversampling factor, by log2 of the factor
+static const std::vector<std::string> OVERSAMPLING_LABELS = {"Off", "2x", "4x", "8x"};
+
+inline size_t oversamplingIndex(int factor) {
+	return (factor >= 8) ? 3 : (factor >= 4) ? 2 : (factor >= 2) ? 1 : 0;
+}
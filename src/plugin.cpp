@@ -2,6 +2,160 @@
 
 Plugin* pluginInstance;
 
+std::shared_ptr<Font> loadPanelFont() {
+	// Rack caches fonts by path, so every label gets the same handle. Build the path only once.
+	static const std::string path = asset::plugin(pluginInstance, "res/Fonts/OverpassMono.ttf");
+	std::shared_ptr<Font> font = APP->window->loadFont(path);
+	if (!font)
+		WARN("Could not load custom font.");
+	return font;
+}
+
+bool isTransportModule(Module* module) {
+	if (!module)
+		return false;
+	return module->model == modelKlok || module->model == modelSecu || module->model == modelBaBum || module->model == modelScener;
+}
+
+void SeededRandom::dataToJson(json_t* rootJ) {
+	if (fixedSeed)
+		json_object_set_new(rootJ, "seed", json_integer(fixedSeed));
+}
+
+void SeededRandom::dataFromJson(json_t* rootJ) {
+	json_t* seedJ = json_object_get(rootJ, "seed");
+	fixedSeed = seedJ ? (uint32_t) json_integer_value(seedJ) : 0;
+	restart();
+}
+
+void SeededRandom::appendContextMenu(Menu* menu) {
+	menu->addChild(createBoolMenuItem("Fixed random seed", fixedSeed ? string::f("%u", fixedSeed) : "",
+		[=]() {return fixedSeed != 0;},
+		[=](bool fixed) {fixedSeed = fixed ? std::max(random::u32(), 1u) : 0;}
+	));
+}
+
+void ProcessTimer::closeWindow() {
+	// Calibrate ticks against the wall clock over everything measured so far
+	uint64_t ticks = now() - startTicks;
+	int64_t ns = nowNs() - startNs;
+	double scale = (ticks > 0 && ns > 0) ? double(ns) / ticks : nsPerTick.load();
+	nsPerTick = scale;
+
+	Summary summary;
+	summary.calls = windowCalls;
+	summary.mean = windowTicks * scale / windowCalls;
+	summary.max = windowMax * scale;
+	uint64_t tail = windowCalls - windowCalls / 100;
+	uint64_t count = 0;
+	for (int i = 0; i < BUCKETS; i++) {
+		count += windowCounts[i];
+		totalCounts[i] += windowCounts[i];
+		if (count >= tail && summary.p99 == 0.f)
+			summary.p99 = std::min(bucketStart(i + 1) * scale, (double) summary.max);
+		windowCounts[i] = 0;
+	}
+	totalTicks += windowTicks;
+	if (windowMax > totalMax)
+		totalMax = windowMax;
+
+	lastVersion++;
+	last = summary;
+	lastVersion++;
+
+	windowTicks = windowMax = 0;
+	windowCalls = 0;
+}
+
+ProcessTimer::Summary ProcessTimer::getLast() {
+	Summary summary;
+	int version;
+	do {
+		version = lastVersion;
+		summary = last;
+	} while ((version & 1) || version != lastVersion);
+	return summary;
+}
+
+ProcessTimer::Summary ProcessTimer::getTotal() {
+	double scale = nsPerTick;
+	Summary summary;
+	uint64_t counts[BUCKETS];
+	for (int i = 0; i < BUCKETS; i++) {
+		counts[i] = totalCounts[i];
+		summary.calls += counts[i];
+	}
+	if (summary.calls == 0)
+		return summary;
+	summary.mean = totalTicks * scale / summary.calls;
+	summary.max = totalMax * scale;
+	uint64_t tail = summary.calls - summary.calls / 100;
+	uint64_t count = 0;
+	for (int i = 0; i < BUCKETS; i++) {
+		count += counts[i];
+		if (count >= tail) {
+			summary.p99 = std::min(bucketStart(i + 1) * scale, (double) summary.max);
+			break;
+		}
+	}
+	return summary;
+}
+
+bool ProcessTimer::exportCsv(const std::string& path) {
+	FILE* file = std::fopen(path.c_str(), "w");
+	if (!file)
+		return false;
+	double scale = nsPerTick;
+	std::fprintf(file, "from_ns,to_ns,calls\n");
+	for (int i = 0; i < BUCKETS; i++) {
+		uint64_t count = totalCounts[i];
+		if (count)
+			std::fprintf(file, "%.2f,%.2f,%llu\n", bucketStart(i) * scale, bucketStart(i + 1) * scale, (unsigned long long) count);
+	}
+	std::fclose(file);
+	return true;
+}
+
+void ProcessTimer::appendContextMenu(Menu* menu, Module* module) {
+	menu->addChild(createSubmenuItem("CPU timing", enabled ? "On" : "",
+		[=](Menu* menu) {
+			menu->addChild(createBoolMenuItem("Time process()", "",
+				[=]() {return enabled.load();},
+				[=](bool on) {
+					if (on)
+						restartPending = true;
+					enabled = on;
+				}
+			));
+			if (!enabled)
+				return;
+
+			Summary window = getLast();
+			Summary total = getTotal();
+			menu->addChild(new MenuSeparator);
+			if (window.calls == 0) {
+				menu->addChild(createMenuLabel("Measuring..."));
+				return;
+			}
+			menu->addChild(createMenuLabel(string::f("Last %d samples, ns per sample:", WINDOW)));
+			menu->addChild(createMenuLabel(string::f("Mean %.1f, p99 %.1f, max %.0f", window.mean, window.p99, window.max)));
+			menu->addChild(createMenuLabel(string::f("Since turned on, %llu samples:", (unsigned long long) total.calls)));
+			menu->addChild(createMenuLabel(string::f("Mean %.1f, p99 %.1f, max %.0f", total.mean, total.p99, total.max)));
+			menu->addChild(createMenuItem("Export histogram to CSV", "",
+				[=]() {
+					std::string dir = asset::user("Ondas");
+					system::createDirectories(dir);
+					std::string path = system::join(dir, string::f("%s-%lld-timing.csv", module->model->slug.c_str(), (long long) module->id));
+					if (exportCsv(path))
+						INFO("Wrote process() timing histogram to %s", path.c_str());
+					else
+						WARN("Could not write %s", path.c_str());
+				}
+			));
+		}
+	));
+}
+
 void init(Plugin* p) {
 	pluginInstance = p;
 
@@ -1,6 +1,12 @@
 #pragma once
 #include <rack.hpp>
+#include <atomic>
+#include <chrono>
 #include <string>
+#if defined ARCH_X64
+	#include <x86intrin.h>
+#endif
+#include "ondas_math.hpp"
 
 using namespace rack;
 
@@ -14,11 +20,450 @@ extern Model* modelBaBum;
 extern Model* modelScener;
 extern Model* modelDistroi;
 
-struct StateButton : SVGSwitch {
-	StateButton() {
-		momentary = false;
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/GUI/StateButton_0.svg")));
-		addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/GUI/StateButton_1.svg")));
+// Number of samples between two polls of knobs and CV
+const int CONTROL_RATE_DIVISION = 32;
+
+/** Decides when a module reads its knobs and CV and recomputes the coefficients derived from them.
+Call process() once per sample. It returns true every `division` samples, and on the first sample after invalidate(),
+which modules call when the sample rate changes. During such a forced poll `forced` is true and every coefficient
+should be recomputed, changed or not.
+*/
+struct ControlRate {
+	dsp::ClockDivider divider;
+	bool stale = true;
+	bool forced = false;
+
+	ControlRate(int division = CONTROL_RATE_DIVISION) {
+		divider.setDivision(division);
+	}
+
+	void setDivision(int division) {
+		divider.setDivision(division);
+		stale = true;
+	}
+
+	int getDivision() {
+		return divider.getDivision();
+	}
+
+	void invalidate() {
+		stale = true;
+	}
+
+	bool process() {
+		if (stale) {
+			stale = false;
+			forced = true;
+			divider.reset();
+			return true;
+		}
+		forced = false;
+		return divider.process();
+	}
+};
+
+inline bool controlEquals(float a, float b) {
+	return a == b;
+}
+
+inline bool controlEquals(simd::float_4 a, simd::float_4 b) {
+	return simd::movemask(a != b) == 0;
+}
+
+/** A value polled at control rate and ramped linearly towards at audio rate, so it doesn't zipper. */
+template <typename T = float>
+struct TSmoothedControl {
+	T value = 0.f;
+	T target = 0.f;
+	T delta = 0.f;
+	int remaining = 0;
+
+	void reset(T v) {
+		value = target = v;
+		delta = 0.f;
+		remaining = 0;
+	}
+
+	/** Ramps to `newTarget` over the next `samples` calls to process(). Returns false if the target didn't change. */
+	bool setTarget(T newTarget, int samples) {
+		if (controlEquals(newTarget, target))
+			return false;
+		target = newTarget;
+		delta = (target - value) / (float) samples;
+		remaining = samples;
+		return true;
+	}
+
+	T process() {
+		if (remaining > 0) {
+			remaining--;
+			value = (remaining == 0) ? target : value + delta;
+		}
+		return value;
+	}
+};
+
+typedef TSmoothedControl<> SmoothedControl;
+
+// Number of samples between two light updates, about 190 times per second at 48 kHz. The UI draws at 60 fps.
+const int LIGHT_RATE_DIVISION = 256;
+
+/** Decides when a module writes its lights. Lights are read by the UI thread a few dozen times per second, so modules
+work out their brightness from the audio state every LIGHT_RATE_DIVISION samples instead of every sample.
+*/
+struct LightRate {
+	dsp::ClockDivider divider;
+
+	LightRate() {
+		divider.setDivision(LIGHT_RATE_DIVISION);
+	}
+
+	/** Call once per sample. Returns true when the lights are due. */
+	bool process() {
+		return divider.process();
+	}
+
+	/** Time between two updates, for lights that fade */
+	float getDeltaTime(float sampleTime) {
+		return sampleTime * divider.getDivision();
+	}
+};
+
+/** Highest brightness of a light since its last update, so a pulse shorter than a LightRate period still shows. */
+struct LightPeak {
+	float peak = 0.f;
+
+	void hold(float brightness) {
+		peak = std::max(peak, brightness);
+	}
+
+	/** Returns the peak and starts over */
+	float take() {
+		float p = peak;
+		peak = 0.f;
+		return p;
+	}
+};
+
+/** Opt-in timing of a module's process(), turned on in its context menu. Rack's meter shows one average per module,
+but xruns come from single slow samples, so this keeps a histogram of every call and reports the tail.
+While off it costs one load per sample. Put a Scope at the top of process().
+*/
+struct ProcessTimer {
+	// Log-spaced buckets of timer ticks, 4 per octave
+	static const int BUCKETS = 4 * 40;
+	// Calls summarized in the menu, about 1.4 s at 48 kHz
+	static const int WINDOW = 1 << 16;
+
+	struct Scope {
+		ProcessTimer& timer;
+		bool on;
+		uint64_t start = 0;
+
+		Scope(ProcessTimer& timer) : timer(timer), on(timer.enabled.load(std::memory_order_relaxed)) {
+			if (on)
+				start = now();
+		}
+
+		~Scope() {
+			if (on)
+				timer.record(now() - start);
+		}
+	};
+
+	/** Summary of a run of calls, in ns per call */
+	struct Summary {
+		uint64_t calls = 0;
+		float mean = 0.f;
+		float p99 = 0.f;
+		float max = 0.f;
+	};
+
+	std::atomic<bool> enabled{false};
+	std::atomic<bool> restartPending{false};
+
+	// Audio thread
+	uint32_t windowCounts[BUCKETS] = {};
+	uint64_t windowTicks = 0;
+	uint64_t windowMax = 0;
+	int windowCalls = 0;
+	uint64_t startTicks = 0;
+	int64_t startNs = 0;
+
+	// Written by the audio thread, read by the UI thread
+	uint64_t totalCounts[BUCKETS] = {};
+	std::atomic<uint64_t> totalTicks{0};
+	std::atomic<uint64_t> totalMax{0};
+	std::atomic<double> nsPerTick{1.0};
+	Summary last; // Last full window
+	std::atomic<int> lastVersion{0}; // Odd while `last` is being written
+
+	/** Cycle counter where there's one, nanoseconds elsewhere */
+	static uint64_t now() {
+#if defined ARCH_X64
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	static int64_t nowNs() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static int bucket(uint64_t ticks) {
+		if (ticks < 4)
+			return ticks;
+		int octave = 63 - __builtin_clzll(ticks);
+		int sub = (ticks >> (octave - 2)) & 3;
+		return std::min(4 * octave + sub - 4, BUCKETS - 1);
+	}
+
+	/** Smallest tick count of bucket `i`. Bucket i spans up to bucketStart(i + 1). */
+	static uint64_t bucketStart(int i) {
+		if (i < 4)
+			return i;
+		int octave = i / 4 + 1;
+		return uint64_t(4 + i % 4) << (octave - 2);
+	}
+
+	void record(uint64_t ticks) {
+		if (restartPending.exchange(false))
+			restart();
+		int b = bucket(ticks);
+		windowCounts[b]++;
+		windowTicks += ticks;
+		windowMax = std::max(windowMax, ticks);
+		if (++windowCalls == WINDOW)
+			closeWindow();
+	}
+
+	void restart() {
+		for (int i = 0; i < BUCKETS; i++) {
+			windowCounts[i] = 0;
+			totalCounts[i] = 0;
+		}
+		windowTicks = windowMax = 0;
+		windowCalls = 0;
+		totalTicks = 0;
+		totalMax = 0;
+		startTicks = now();
+		startNs = nowNs();
+	}
+
+	// Defined in plugin.cpp
+	void closeWindow();
+	Summary getLast();
+	Summary getTotal();
+	bool exportCsv(const std::string& path);
+	void appendContextMenu(Menu* menu, Module* module);
+};
+
+/** xoshiro128+ running in four SIMD lanes, each lane its own stream. One call gives four uniforms, cheap enough to
+draw every sample, and the generator belongs to the module, so a fixed seed makes its randomness repeat.
+*/
+struct Random {
+	simd::int32_4 s[4];
+	simd::float_4 block; // Uniforms not handed out by uniform() yet
+	int used = 4;
+	simd::float_4 spare; // Second half of the last Box-Muller pair
+	bool spareReady = false;
+
+	Random() {
+		seed(random::u64());
+	}
+
+	void seed(uint64_t seed) {
+		// Expand the seed with splitmix64, which never gives a lane an all-zero state
+		for (int i = 0; i < 4; i++) {
+			for (int l = 0; l < 4; l += 2) {
+				uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+				z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+				z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+				z ^= z >> 31;
+				s[i][l] = (int32_t) z;
+				s[i][l + 1] = (int32_t) (z >> 32);
+			}
+		}
+		used = 4;
+		spareReady = false;
+	}
+
+	static simd::int32_4 shiftRight(simd::int32_4 x, int k) {
+		return simd::int32_4(_mm_srli_epi32(x.v, k));
+	}
+
+	simd::int32_4 next() {
+		simd::int32_4 result = s[0] + s[3];
+		simd::int32_4 t = s[1] << 9;
+		s[2] = s[2] ^ s[0];
+		s[3] = s[3] ^ s[1];
+		s[1] = s[1] ^ s[2];
+		s[0] = s[0] ^ s[3];
+		s[2] = s[2] ^ t;
+		s[3] = (s[3] << 11) | shiftRight(s[3], 21);
+		return result;
+	}
+
+	/** Four uniforms in [0, 1), from the top 24 bits of each lane, which are the strongest of xoshiro128+ */
+	simd::float_4 uniform4() {
+		return simd::float_4(shiftRight(next(), 8)) * (1.f / 16777216.f);
+	}
+
+	/** Four standard normals, with the Box-Muller transform */
+	simd::float_4 normal4() {
+		if (spareReady) {
+			spareReady = false;
+			return spare;
+		}
+		simd::float_4 radius = simd::sqrt(-2.f * fastmath::LN2 * fastmath::log2(1.f - uniform4()));
+		simd::float_4 turns = uniform4();
+		spare = radius * fastmath::cos2pi(turns);
+		spareReady = true;
+		return radius * fastmath::sin2pi(turns);
+	}
+
+	/** One uniform in [0, 1), handed out from a block of four */
+	float uniform() {
+		if (used == 4) {
+			block = uniform4();
+			used = 0;
+		}
+		return block[used++];
+	}
+
+	/** Trials up to and including the first success when each succeeds with chance `p`, from the geometric
+	distribution. Waits this long for an event instead of drawing a uniform on every sample. INT32_MAX if p is 0.
+	*/
+	int geometric(float p) {
+		if (p <= 0.f)
+			return INT32_MAX;
+		double trials = std::floor(std::log(1.0 - uniform()) / std::log1p(-(double) p)) + 1.0;
+		return (int) std::min(trials, (double) INT32_MAX);
+	}
+};
+
+/** The Random of a module, with the seed the user can fix from the context menu. Without a fixed seed every instance
+gets a fresh one. With it, the randomness starts over from the seed when the patch loads, so renders repeat.
+*/
+struct SeededRandom : Random {
+	uint32_t fixedSeed = 0; // 0 when not fixed
+
+	/** Starts over from the fixed seed, if any. Returns false if the seed isn't fixed. */
+	bool restart() {
+		if (!fixedSeed)
+			return false;
+		seed(fixedSeed);
+		return true;
+	}
+
+	// Defined in plugin.cpp
+	void dataToJson(json_t* rootJ);
+	void dataFromJson(json_t* rootJ);
+	void appendContextMenu(Menu* menu);
+};
+
+/** Klok's transport, passed along a row of adjacent Ondas modules with expander messages instead of cables.
+A module reads what its neighbour wrote one frame later, so instead of sending ticks as they happen Klok announces the
+frame of its next tick. Every module then acts on that frame itself and the whole row ticks together with Klok,
+however far it is.
+*/
+struct TransportMessage {
+	int64_t sentFrame = -1; // Frame the neighbour wrote the message in. Older messages are stale.
+	int hops = 0; // Modules between Klok and the receiver, 1 for its neighbours
+	bool clocked = false; // Whether there's a Klok up the row
+	bool running = false;
+	int64_t nextTick = -1; // Frame of Klok's next tick
+	int64_t resetFrame = -1; // Frame Klok last started running, which resets the row
+	int64_t gatesTick = -1; // Frame Secu fires the tracks in `gates` on, one bit per track
+	int gates = 0;
+};
+
+// Whether `module` is an Ondas module that takes part in the transport, defined in plugin.cpp
+bool isTransportModule(Module* module);
+
+/** Receives the transport on either side of a module and passes it on to the other side. */
+struct TransportLink {
+	TransportMessage leftMessages[2];
+	TransportMessage rightMessages[2];
+	TransportMessage transport; // Last fresh message received
+	int source = -1; // Side it came from: 0 left, 1 right, -1 none
+	// Announced frames already acted on
+	int64_t lastTick = -1;
+	int64_t lastReset = -1;
+	int64_t lastGates = -1;
+
+	/** Call in the module constructor */
+	void setup(Module* module) {
+		module->leftExpander.producerMessage = &leftMessages[0];
+		module->leftExpander.consumerMessage = &leftMessages[1];
+		module->rightExpander.producerMessage = &rightMessages[0];
+		module->rightExpander.consumerMessage = &rightMessages[1];
+	}
+
+	static const TransportMessage* fresh(Module::Expander& expander, int64_t frame) {
+		if (!isTransportModule(expander.module))
+			return NULL;
+		const TransportMessage* message = (const TransportMessage*) expander.consumerMessage;
+		return (message->sentFrame == frame - 1) ? message : NULL;
+	}
+
+	/** Reads the neighbours' messages, preferring the side closer to a Klok. Returns false if neither sent one. */
+	bool receive(Module* module, int64_t frame) {
+		const TransportMessage* left = fresh(module->leftExpander, frame);
+		const TransportMessage* right = fresh(module->rightExpander, frame);
+		if (left && right && (right->clocked > left->clocked || (right->clocked == left->clocked && right->hops < left->hops)))
+			left = NULL;
+		source = left ? 0 : right ? 1 : -1;
+		if (source < 0) {
+			transport = TransportMessage();
+			return false;
+		}
+		transport = left ? *left : *right;
+		return true;
+	}
+
+	/** Writes `message` to the neighbour on `side` (0 left, 1 right), which reads it next frame */
+	static void send(Module* module, int side, const TransportMessage& message, int64_t frame) {
+		Module::Expander& expander = side ? module->rightExpander : module->leftExpander;
+		if (!isTransportModule(expander.module))
+			return;
+		Module::Expander& other = side ? expander.module->leftExpander : expander.module->rightExpander;
+		TransportMessage* producer = (TransportMessage*) other.producerMessage;
+		*producer = message;
+		producer->sentFrame = frame;
+		other.requestMessageFlip();
+	}
+
+	/** Sends `message` to the side it didn't come from, or to both sides if it starts here */
+	void forward(Module* module, TransportMessage message, int64_t frame) {
+		message.hops++;
+		if (source != 0)
+			send(module, 0, message, frame);
+		if (source != 1)
+			send(module, 1, message, frame);
+	}
+
+	/** True on the frame of each of Klok's ticks */
+	bool tick(int64_t frame) {
+		return due(transport.running ? transport.nextTick : -1, lastTick, frame);
+	}
+
+	/** True on the frame Klok starts running */
+	bool reset(int64_t frame) {
+		return due(transport.resetFrame, lastReset, frame);
+	}
+
+	/** True on the frame Secu fires the tracks in transport.gates */
+	bool gates(int64_t frame) {
+		return due(transport.gatesTick, lastGates, frame);
+	}
+
+	static bool due(int64_t announced, int64_t& last, int64_t frame) {
+		if (announced < 0 || announced <= last || frame < announced)
+			return false;
+		last = announced;
+		return true;
 	}
 };
 
@@ -28,11 +473,17 @@ struct RoundSmallBlackSnapKnob : RoundSmallBlackKnob {
 	}
 };
 
+// Panel font shared by every Ondas label, defined in plugin.cpp
+std::shared_ptr<Font> loadPanelFont();
+
+/** One line of panel text. The font is looked up when the text is drawn and its bounds are measured only after the
+text changes, so a label inside a LabelLayer costs nothing until the layer is redrawn.
+*/
 struct TextDisplayWidget : TransparentWidget {
 	int fontSize;
 	int align;
 	std::string displayText;
-	std::shared_ptr<Font> customFont;
+	bool measured = false;
 	
 	TextDisplayWidget(const std::string& text, Vec pos, int fs, int a = 0) {
 		// Set the box size of the widget
@@ -41,9 +492,16 @@ struct TextDisplayWidget : TransparentWidget {
 		box.size = Vec(0, 0);
 		box.pos = mm2px(pos);
 		align = a;
-		customFont = APP->window->loadFont(asset::plugin(pluginInstance, "res/Fonts/OverpassMono.ttf"));
-		if (!customFont)
-			WARN("Could not load custom font.");
+	}
+
+	void setText(const std::string& text) {
+		if (text == displayText)
+			return;
+		displayText = text;
+		measured = false;
+		FramebufferWidget* fb = getAncestorOfType<FramebufferWidget>();
+		if (fb)
+			fb->setDirty();
 	}
 
 	void draw(const DrawArgs& args) override {
@@ -56,8 +514,9 @@ struct TextDisplayWidget : TransparentWidget {
 		const char* text = displayText.c_str();
 
 		nvgFontSize(args.vg, fontSize);  // Font size
-		if (customFont) {
-			nvgFontFaceId(args.vg, customFont->handle);
+		std::shared_ptr<Font> font = loadPanelFont();
+		if (font) {
+			nvgFontFaceId(args.vg, font->handle);
 		} else {
 			// Fallback to default font
 			nvgFontFaceId(args.vg, APP->window->uiFont->handle);
@@ -67,11 +526,14 @@ struct TextDisplayWidget : TransparentWidget {
 		NVGcolor textColor = nvgRGB(0, 0, 0);
 		nvgFillColor(args.vg, textColor);
 
-		float bounds[4];
-		nvgTextBounds(args.vg, 0, 0, text, nullptr, bounds);
-		float textWidth = bounds[2] - bounds[0];
-		float textHeight = bounds[3] - bounds[1];
-		box.size = Vec(textWidth + 4, textHeight + 4); // Add some padding
+		if (!measured) {
+			float bounds[4];
+			nvgTextBounds(args.vg, 0, 0, text, nullptr, bounds);
+			float textWidth = bounds[2] - bounds[0];
+			float textHeight = bounds[3] - bounds[1];
+			box.size = Vec(textWidth + 4, textHeight + 4); // Add some padding
+			measured = true;
+		}
 
 		// Draw the text at a specific position
 		int alignment;
@@ -86,4 +548,20 @@ struct TextDisplayWidget : TransparentWidget {
 		nvgTextAlign(args.vg, alignment | NVG_ALIGN_MIDDLE);
 		nvgText(args.vg, 0, 0, text, nullptr);
 	}
-};
\ No newline at end of file
+};
+
+/** Holds the static text of a panel. The labels are rendered once into a framebuffer, which Rack only redraws when
+the zoom level changes or a label's text does.
+*/
+struct LabelLayer : FramebufferWidget {
+	LabelLayer(Vec size) {
+		box.size = size;
+	}
+
+	TextDisplayWidget* addLabel(const std::string& text, Vec pos, int fs, int a = 0) {
+		TextDisplayWidget* label = new TextDisplayWidget(text, pos, fs, a);
+		addChild(label);
+		setDirty();
+		return label;
+	}
+};